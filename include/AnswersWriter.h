@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+// Потоковая запись ответов: каждый ответ сериализуется и отправляется в файл сразу
+// при записи, дерево всего документа в памяти не строится. Структура документа
+// одинакова во всех форматах, кроме JSON Lines: {"answers": {"request001": {...}, ...}}.
+// Ошибки открытия и записи сообщаются исключением std::runtime_error.
+class AnswersWriter {
+public:
+    enum class Format {
+        Json,        // JSON с отступом в 4 пробела
+        Compact,     // JSON без пробелов и переводов строк
+        Cbor,        // CBOR (RFC 8949), кодировщик nlohmann::json
+        MessagePack, // MessagePack, кодировщик nlohmann::json
+        JsonLines    // JSON Lines: ответ на запрос - отдельная строка {"id": ..., ...}
+    };
+
+
+    // Формат по имени из config.json: "json", "compact", "cbor", "msgpack" или "jsonl"; иначе Json
+    static Format ParseFormat(const std::string& name);
+
+
+    // Расширение файла ответов: ".json", ".cbor", ".msgpack" или ".jsonl"
+    static const char* Extension(Format format);
+
+
+    // На каждый запрос записывается не больше max_responses документов (0 - все)
+    AnswersWriter(const std::string& path, Format format, size_t max_responses);
+
+
+    // Завершает документ, если Finish не был вызван
+    ~AnswersWriter();
+
+
+    AnswersWriter(const AnswersWriter&) = delete;
+
+
+    AnswersWriter& operator=(const AnswersWriter&) = delete;
+
+
+    // Ответ на очередной запрос: номера документов и релевантность по убыванию.
+    // id - значение поля id в JSON Lines, готовый JSON (число или строка в кавычках), который
+    // пишется как есть; пустой - строка requestNNN по номеру ответа. В остальных форматах
+    // ключ ответа всегда requestNNN.
+    void Write(const std::vector<std::pair<int, float>>& answer, std::string_view id = {});
+
+
+    // Отдаёт записанные ответы в файл, не завершая документ
+    void Flush();
+
+
+    // Завершает документ и закрывает файл
+    void Finish();
+
+
+    size_t Count() const { return count; }
+
+
+    const std::string& Path() const { return path; }
+
+private:
+    std::string path;
+    std::ofstream file;
+    Format format;
+    size_t max_responses;
+    size_t count = 0;
+    bool finished = false;
+    std::streamoff count_offset = 0; // место числа ответов в заголовке двоичных форматов
+    std::string text;                // буфер ответа в текстовых форматах
+    std::vector<uint8_t> bytes;      // буфер ответа в двоичных форматах
+
+
+    void WriteText(const std::string& request_id, std::string_view id, const std::vector<std::pair<int, float>>& answer,
+                   size_t size);
+
+
+    void WriteBinary(const std::string& request_id, const std::vector<std::pair<int, float>>& answer, size_t size);
+};
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+
+// Массив, который до первого изменения читается из подключённой памяти (например,
+// секции отображённого сегмента) без копирования. Копия подключённого массива
+// копирует только указатель; Mutable переносит данные в собственный вектор.
+template <typename T>
+class AttachedArray {
+public:
+    AttachedArray() = default;
+
+
+    AttachedArray(std::vector<T> values) : own(std::move(values)) {}
+
+
+    // Память должна жить дольше массива и его копий
+    void Attach(const T* data, size_t size) {
+        own.clear();
+        own.shrink_to_fit();
+        attached = data;
+        attached_size = size;
+    }
+
+
+    const T* Data() const { return attached ? attached : own.data(); }
+
+
+    size_t Size() const { return attached ? attached_size : own.size(); }
+
+
+    bool Empty() const { return Size() == 0; }
+
+
+    const T& operator[](size_t index) const { return Data()[index]; }
+
+
+    // Собственные данные для изменения; подключённые при первом вызове копируются
+    std::vector<T>& Mutable() {
+        if (attached) {
+            own.assign(attached, attached + attached_size);
+            attached = nullptr;
+        }
+        return own;
+    }
+
+
+    // Размер в памяти, включая подключённые данные
+    size_t MemoryUsage() const { return (attached ? attached_size : own.capacity()) * sizeof(T); }
+
+private:
+    std::vector<T> own;
+    const T* attached = nullptr; // пока задан, own не используется
+    size_t attached_size = 0;
+};
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+// Упаковка блоков по 128 чисел фиксированной разрядности.
+// Числа раскладываются по 8 полосам (число i - в полосу i % 8), и слово w
+// каждой полосы хранится по адресу w * 8 + полоса. Благодаря такой раскладке
+// один и тот же блок распаковывается и скалярным кодом, и SSE2 (две половины
+// по 4 полосы), и AVX2 (все 8 полос сразу).
+namespace BitPacking {
+    constexpr size_t block_size = 128;
+    constexpr size_t lanes = 8;
+
+
+    // Наименьшая разрядность, вмещающая все значения
+    uint32_t RequiredBits(const uint32_t* values, size_t count);
+
+
+    // Число 32-битных слов, занимаемых count значениями разрядности bits.
+    // Неполный блок хранит только нужные группы по 8 значений.
+    constexpr size_t PackedWords(uint32_t bits, size_t count = block_size) {
+        return lanes * (((count + lanes - 1) / lanes * bits + 31) / 32);
+    }
+
+
+    // Упаковывает count <= block_size значений, out должен вмещать PackedWords(bits, count) слов
+    void Pack(const uint32_t* values, size_t count, uint32_t bits, uint32_t* out);
+
+
+    // out[i] = значение i + add. Распаковываются целые группы по 8 значений,
+    // поэтому out должен вмещать block_size значений.
+    void Unpack(const uint32_t* in, size_t count, uint32_t bits, uint32_t add, uint32_t* out);
+
+
+    // out[i] = base + сумма значений 0..i (восстановление из разностей)
+    void UnpackDelta(const uint32_t* in, size_t count, uint32_t bits, uint32_t base, uint32_t* out);
+
+
+    // Имя реализации, выбранной при запуске: "avx2", "sse2" или "scalar"
+    const char* DecoderName();
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+
+// Очередь ограниченной ёмкости между производителем и потребителем: Push ждёт,
+// пока в очереди есть место, поэтому быстрый производитель не накапливает данные
+// в памяти. После Close новые элементы не принимаются, а оставшиеся можно забрать.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity > 0 ? capacity : 1) {}
+
+
+    // Ждёт места и добавляет элемент; false - очередь закрыта, элемент не добавлен
+    bool Push(T&& value) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [this]() { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+
+        items.push_back(std::move(value));
+        lock.unlock();
+        not_empty.notify_one();
+        return true;
+    }
+
+
+    // Ждёт хотя бы один элемент и забирает в batch (после очистки) не больше max_count
+    // имеющихся. false - очередь закрыта и пуста.
+    bool PopBatch(std::vector<T>& batch, size_t max_count) {
+        batch.clear();
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this]() { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+
+        while (!items.empty() && batch.size() < max_count) {
+            batch.push_back(std::move(items.front()));
+            items.pop_front();
+        }
+        lock.unlock();
+        not_full.notify_all();
+        return true;
+    }
+
+
+    // Больше элементов не будет: будит ждущих производителей и потребителей
+    void Close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+
+private:
+    const size_t capacity;
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    bool closed = false;
+};
\ No newline at end of file
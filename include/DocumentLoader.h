@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+
+// Параллельная загрузка файлов документов на пуле потоков. Крупные файлы отображаются
+// в память, мелкие читаются пачками в общий буфер пачки одним чтением на файл, чтобы
+// на каждый файл не приходилось ни отдельной задачи, ни отдельного выделения памяти.
+// Тексты отдаются как string_view и действительны, пока жив загрузчик.
+class DocumentLoader {
+public:
+    // Файлы не меньше этого размера отображаются в память
+    static constexpr size_t mapping_threshold = size_t(256) << 10;
+
+    // Пачка мелких файлов - не больше batch_files файлов и batch_bytes байт
+    static constexpr size_t batch_files = 64;
+    static constexpr size_t batch_bytes = size_t(4) << 20;
+
+
+    enum class Status { Loaded, Missing, Unreadable };
+
+
+    struct File {
+        Status status = Status::Missing;
+        std::string_view content;
+        int64_t write_time = 0; // как fs::last_write_time(...).time_since_epoch().count()
+    };
+
+
+    explicit DocumentLoader(ThreadPool& pool) : pool(pool) {}
+
+
+    // Загружает файлы paths вместо загруженных ранее. Ошибки чтения отдельных
+    // файлов не прерывают загрузку, а отражаются в статусе файла.
+    void Load(const std::vector<std::string>& paths);
+
+
+    // Файл paths[index] последней загрузки
+    const File& GetFile(size_t index) const { return files[index]; }
+
+
+    // Прочитано байт и затрачено секунд при последней загрузке
+    size_t LoadedBytes() const { return loaded_bytes; }
+
+
+    double LoadSeconds() const { return load_seconds; }
+
+private:
+    ThreadPool& pool;
+    std::vector<File> files;
+    std::vector<std::unique_ptr<MappedFile>> mappings;
+    std::vector<std::unique_ptr<char[]>> buffers; // буферы пачек мелких файлов
+    size_t loaded_bytes = 0;
+    double load_seconds = 0;
+};
\ No newline at end of file
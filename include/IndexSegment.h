@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+
+// Исходный файл документа. Сохраняется в сегменте индекса, чтобы при открытии
+// определить, какие файлы изменились после построения.
+struct SourceFile {
+    static constexpr uint32_t no_document = UINT32_MAX;
+
+    std::string path;
+    uint32_t doc_id = no_document; // номер документа остаётся за файлом, даже если файл исчез
+    bool loaded = false;           // файл прочитан и проиндексирован
+    uint64_t size = 0;
+    int64_t write_time = 0;        // время модификации в единицах file_time_type
+};
+
+
+// Формат файла сегмента индекса: заголовок и секции, выровненные на 8 байт.
+// Секции используются прямо из отображённой памяти, без разбора и копирования.
+// Порядок байтов - как у машины, на которой сегмент записан.
+namespace IndexSegment {
+    constexpr char magic[8] = {'S', 'E', 'S', 'E', 'G', 'M', 'N', 'T'};
+    constexpr uint32_t version = 6;
+
+
+    enum Section : uint32_t {
+        DictionarySlots,  // TermDictionary::Slot[slot_count]
+        TermOffsets,      // uint64_t[term_count + 1]
+        TermArena,        // строки терминов подряд
+        TermLists,        // TermList[term_count]
+        Blocks,           // PostingBlock всех списков подряд
+        Words,            // упакованные данные всех списков подряд
+        ExternalIds,      // uint32_t[document_count]
+        DeletedDocuments, // битовая карта uint64_t[(document_count + 63) / 64]
+        SourceFiles,      // таблица исходных файлов
+        DocumentNorms,    // float[document_count], нормы длины документов
+        PositionOffsets,  // uint64_t для каждой группы из PositionList::group_size вхождений термина
+                          // (термины подряд): начало её позиций в PositionData (пусто - без позиций)
+        PositionData,     // позиции вхождений всех списков подряд (PositionList)
+        InternalIds,      // uint32_t[internal_id_count], внешний doc_id -> внутренний номер
+        section_count
+    };
+
+
+    struct SectionEntry {
+        uint64_t offset;
+        uint64_t size;
+        uint64_t checksum; // по байтам секции, проверяется Reader::Verify
+    };
+
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t header_size;
+        uint64_t file_size;
+        uint64_t checksum;          // заголовка, считается с нулём в этом поле
+        uint64_t term_count;
+        uint64_t slot_count;
+        uint64_t document_count;    // внутренних номеров, включая удалённые
+        uint64_t internal_id_count; // наибольший внешний doc_id + 1
+        uint64_t deleted_count;
+        uint64_t deleted_pending;
+        double average_length;      // средняя длина документа при построении
+        float minimum_norm;         // наименьшая из DocumentNorms
+        uint32_t identity_ids;      // 1 - внутренние номера совпадают с внешними
+        SectionEntry sections[section_count];
+    };
+
+
+    // Положение списка вхождений термина в секциях Blocks и Words
+    struct TermList {
+        uint64_t first_block;
+        uint64_t first_word;
+        uint32_t block_count;
+        uint32_t word_count;
+        uint32_t size;
+        uint32_t max_count;   // наибольшая частота в списке, для плана запроса без чтения блоков
+        uint64_t first_group; // первая группа позиций термина в PositionOffsets
+    };
+
+
+    uint64_t Checksum(const char* data, size_t size);
+
+
+    std::string EncodeSources(const std::vector<SourceFile>& sources);
+
+
+    std::vector<SourceFile> DecodeSources(const char* data, size_t size);
+
+
+    // Записывает секции во временный файл; Commit дописывает заголовок
+    // с контрольной суммой и заменяет им файл path, так что открытый
+    // в это время сегмент остаётся целым
+    class Writer {
+    public:
+        explicit Writer(const std::string& path);
+
+
+        Header& GetHeader() { return header; }
+
+
+        void BeginSection(Section section);
+
+
+        void Write(const void* data, size_t size);
+
+
+        void EndSection();
+
+
+        void WriteSection(Section section, const void* data, size_t size) {
+            BeginSection(section);
+            Write(data, size);
+            EndSection();
+        }
+
+
+        void Commit();
+
+    private:
+        std::string path;
+        std::string temp_path;
+        std::ofstream out;
+        Header header{};
+        uint64_t position = sizeof(Header);
+        Section current = section_count;
+    };
+
+
+    // Отображает сегмент в память и проверяет заголовок и границы секций; сами секции
+    // при открытии не читаются. Их контрольные суммы проверяют VerifySection и Verify.
+    // Ошибки сообщаются исключением std::runtime_error.
+    class Reader {
+    public:
+        explicit Reader(const std::string& path);
+
+
+        const Header& GetHeader() const { return *header; }
+
+
+        // Сверяет контрольную сумму секции
+        void VerifySection(Section section) const;
+
+
+        // Сверяет контрольные суммы всех секций, то есть читает весь файл
+        void Verify() const;
+
+
+        const char* SectionData(Section section) const { return file->Data() + header->sections[section].offset; }
+
+
+        size_t SectionSize(Section section) const { return header->sections[section].size; }
+
+
+        // Секция из count элементов типа T; размер должен совпадать
+        template <typename T>
+        const T* SectionArray(Section section, size_t count) const {
+            if (SectionSize(section) != count * sizeof(T)) {
+                throw std::runtime_error("index segment section " + std::to_string(section) + " has wrong size");
+            }
+            return reinterpret_cast<const T*>(SectionData(section));
+        }
+
+
+        // Файл должен жить, пока используются данные секций
+        std::shared_ptr<const MappedFile> File() const { return file; }
+
+    private:
+        std::shared_ptr<const MappedFile> file;
+        const Header* header = nullptr;
+    };
+}
\ No newline at end of file
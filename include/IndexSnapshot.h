@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include "AttachedArray.h"
+#include "MappedFile.h"
+#include "PositionList.h"
+#include "PostingList.h"
+#include "PostingTable.h"
+#include "TermDictionary.h"
+
+
+// Одно поколение индекса. Опубликованный снимок не меняется: читатели берут его
+// через InvertedIndex::Snapshot() и работают без блокировок, а изменения индекса
+// собираются в новом снимке, который затем заменяет текущий.
+class IndexSnapshot {
+public:
+    // Список вхождений слова без копирования; действует, пока жив снимок
+    PostingsView GetPostings(std::string_view word) const;
+
+
+    // Позиции вхождений слова; nullptr - слова нет или индекс построен без позиций
+    const PositionList* GetPositions(std::string_view word) const;
+
+
+    // Идентификатор слова в словаре (слово приводится к нижнему регистру), TermDictionary::npos -
+    // слова нет. По идентификатору список и позиции берутся без повторного поиска в словаре.
+    uint32_t FindTerm(std::string_view word) const;
+
+
+    PostingsView GetPostings(uint32_t term_id) const;
+
+
+    const PositionList* GetPositions(uint32_t term_id) const;
+
+
+    // Индекс хранит позиции слов, по ним проверяются фразы и близость
+    bool HasPositions() const { return postings.HasPositions(); }
+
+
+    // Число документов без учёта удалённых
+    size_t GetDocumentCount() const { return external_ids.Size() - deleted_count; }
+
+
+    size_t GetTermCount() const { return dictionary->Size() + added_terms.Size(); }
+
+
+    // Внешний doc_id по внутреннему номеру из списка вхождений
+    uint32_t ExternalId(uint32_t internal_id) const {
+        return identity_ids ? internal_id : external_ids[internal_id];
+    }
+
+
+    // Внутренние номера совпадают с внешними, порядок обхода списков - порядок doc_id
+    bool IdentityIds() const { return identity_ids; }
+
+
+    // Нормы длины по внутренним номерам: число слов документа / средняя длина при построении
+    const float* DocumentNorms() const { return document_norms.Data(); }
+
+
+    // Наименьшая норма длины, нужна для верхних границ релевантности
+    float MinimumNorm() const { return minimum_norm; }
+
+
+    // Нормы длины для документов с числом слов lengths; average_length - средняя длина
+    static std::vector<float> LengthNorms(const std::vector<uint32_t>& lengths, double& average_length);
+
+
+    size_t GetDictionaryMemoryUsage() const { return dictionary->MemoryUsage() + added_terms.MemoryUsage(); }
+
+
+    // Общее число вхождений во всех списках
+    size_t GetPostingsCount() const;
+
+
+    size_t GetPostingsMemoryUsage() const;
+
+
+    size_t GetPositionsMemoryUsage() const;
+
+
+    // Размер сегмента, из которого открыт снимок, 0 - снимок построен в памяти
+    size_t GetSegmentSize() const { return segment ? segment->Size() : 0; }
+
+
+    // Номер поколения: растёт при каждой публикации нового снимка
+    uint64_t Generation() const { return generation; }
+
+private:
+    friend class InvertedIndex;
+
+    std::shared_ptr<const MappedFile> segment; // на него ссылаются словарь, списки и таблицы документов, поэтому объявлен первым
+    // Словарь делится между копиями снимка и после публикации не меняется. Термины, добавленные
+    // позже, копятся в небольшом added_terms (их идентификаторы продолжают dictionary), поэтому
+    // изменение снимка не копирует весь словарь; InvertedIndex время от времени сливает их.
+    std::shared_ptr<TermDictionary> dictionary = std::make_shared<TermDictionary>(); // термин -> идентификатор
+    TermDictionary added_terms;
+    PostingTable postings; // сжатые списки вхождений и позиции по идентификатору термина
+    uint64_t generation = 0;
+
+    // Списки вхождений хранят внутренние номера документов: новый или изменённый документ
+    // получает следующий номер, поэтому вхождения всегда дописываются в конец списков.
+    // После полной перестройки внутренние номера совпадают с внешними.
+    AttachedArray<uint32_t> external_ids; // внутренний номер -> внешний doc_id
+    AttachedArray<uint32_t> internal_ids; // внешний doc_id -> внутренний номер (npos - нет документа)
+    bool identity_ids = true; // номера совпадают, отображение можно не применять
+    AttachedArray<uint64_t> deleted; // битовая карта удалённых внутренних номеров
+    size_t deleted_count = 0; // всего удалённых внутренних номеров
+    size_t deleted_pending = 0; // удалённых, но ещё не вычищенных из списков
+
+    // Статистика длин считается один раз при построении; добавленные позже документы
+    // нормируются той же средней длиной до следующей перестройки
+    AttachedArray<float> document_norms; // по внутреннему номеру
+    double average_length = 0;
+    float minimum_norm = 0;
+
+
+    const uint64_t* DeletedBitmap() const { return deleted_pending > 0 ? deleted.Data() : nullptr; }
+
+
+    // Идентификатор термина в нижнем регистре в обоих словарях
+    uint32_t FindLowerTerm(std::string_view term) const;
+};
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+// Пересечение возрастающих массивов doc_id. Для каждого общего значения ядра
+// записывают его позицию в a (a_positions) и в b (b_positions), чтобы вызывающий
+// мог сложить частоты обоих списков. Массивы позиций должны вмещать min(a_size, b_size)
+// значений. Возвращается число совпадений.
+namespace Intersection {
+    // Если один массив длиннее другого хотя бы во столько раз, выгоднее галоп
+    constexpr size_t gallop_ratio = 16;
+
+
+    // Слияние двумя указателями, O(a_size + b_size)
+    size_t Merge(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size,
+                 uint32_t* a_positions, uint32_t* b_positions);
+
+
+    // Каждое значение короткого a ищется в длинном b экспоненциальным поиском
+    // от предыдущей находки, O(a_size * log(b_size / a_size))
+    size_t Gallop(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size,
+                  uint32_t* a_positions, uint32_t* b_positions);
+
+
+    // Значение a сравнивается сразу с блоком из 8 (AVX2) или 4 (SSE2) значений b,
+    // блоки b, целиком меньшие значения, пропускаются. Без SIMD - Merge.
+    size_t Simd(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size,
+                uint32_t* a_positions, uint32_t* b_positions);
+
+
+    // Выбирает ядро по соотношению длин: галоп для сильно различающихся, иначе SIMD
+    size_t Intersect(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size,
+                     uint32_t* a_positions, uint32_t* b_positions);
+
+
+    // Имя SIMD-реализации, выбранной при запуске: "avx2", "sse2" или "scalar"
+    const char* KernelName();
+}
\ No newline at end of file
@@ -1,40 +1,243 @@
 #pragma once
 
+#include <functional>
 #include <vector>
 #include <string>
-#include <map>
+#include <string_view>
+#include <unordered_map>
+#include <memory>
 #include <mutex>
-#include <thread>
+#include "IndexSegment.h"
+#include "IndexSnapshot.h"
+#include "PostingList.h"
+#include "PostingTable.h"
+#include "TermDictionary.h"
+#include "ThreadPool.h"
+#include "Tokenizer.h"
 
 
-struct Entry {
-    size_t doc_id, count;
-    // Данный оператор необходим для проведения тестовых сценариев
-    bool operator ==(const Entry& other) const {
-        return (doc_id == other.doc_id &&
-                count == other.count);
-    }
+// Способ построения частотного словаря
+enum class BuildMode {
+    Locked,  // общий словарь под мьютексом
+    Sharded, // локальные словари потоков и параллельное слияние по шардам
+    Spimi    // во внешней памяти: прогоны во временных файлах и их слияние (SpimiBuilder)
 };
 
 
+// Источник документов для построения: вызывает sink для каждого документа по порядку doc_id
+using DocumentSink = std::function<void(std::string_view)>;
+using DocumentSource = std::function<void(const DocumentSink&)>;
+
+
+// Индекс публикует неизменяемые снимки (IndexSnapshot) через атомарный shared_ptr.
+// Изменения собираются в новом снимке и становятся видны читателям одной заменой
+// указателя, поэтому поиск может идти параллельно с перестройкой индекса.
+// Изменяющие методы выполняются по одному.
 class InvertedIndex {
 public:
     InvertedIndex() = default;
 
 
+    explicit InvertedIndex(ThreadPool& pool) : pool(&pool) {}
+
+
+    // Строит индекс заново; до окончания построения читатели видят прежний снимок
     void UpdateDocumentBase(std::vector<std::string> input_docs);
 
 
+    // То же по текстам, которые хранит вызывающий (например, отображённым в память файлам);
+    // тексты не копируются и должны жить до конца построения
+    void UpdateDocumentBase(const std::vector<std::string_view>& input_docs);
+
+
+    // То же, но документы читаются из источника по одному. В режиме Spimi
+    // корпус целиком в памяти не держится, иначе документы собираются в вектор.
+    void UpdateDocumentBase(const DocumentSource& source);
+
+
+    void SetBuildMode(BuildMode mode) { build_mode = mode; }
+
+
+    // Бюджет памяти построения в режиме Spimi, в байтах
+    void SetMemoryBudget(size_t bytes) { memory_budget = bytes; }
+
+
+    // Каталог временных файлов режима Spimi, пустая строка - системный
+    void SetTempDirectory(const std::string& directory) { temp_directory = directory; }
+
+
+    // Хранить ли позиции слов (для фраз и близости); действует со следующего построения
+    void SetPositions(bool enabled) { store_positions = enabled; }
+
+
+    // Добавляет документ с номером doc_id, затрагивая только списки его слов.
+    // Если документ с таким номером уже есть, бросает std::invalid_argument.
+    void AddDocument(size_t doc_id, const std::string& content);
+
+
+    // Заменяет содержимое документа (или добавляет его, если документа нет)
+    void UpdateDocument(size_t doc_id, const std::string& content);
+
+
+    // Помечает документ удалённым; списки вхождений вычищаются позже, когда
+    // удалённых документов накопится достаточно. Возвращает false, если документа нет.
+    bool RemoveDocument(size_t doc_id);
+
+
+    // Вычищает удалённые документы из всех списков вхождений
+    void Compact();
+
+
+    // Изменения между BeginUpdate и EndUpdate публикуются одним снимком.
+    // Пока пакет открыт, другие потоки не могут изменять индекс.
+    void BeginUpdate();
+
+
+    void EndUpdate();
+
+
+    // Записывает текущий снимок в файл сегмента вместе с таблицей исходных файлов
+    void Save(const std::string& path, const std::vector<SourceFile>& sources) const;
+
+
+    // Открывает сегмент, записанный Save: словарь, списки вхождений и таблицы документов
+    // читаются прямо из отображённого в память файла. Проверяются заголовок и границы секций,
+    // контрольные суммы секций - только IndexSegment::Reader::Verify. Возвращает таблицу
+    // исходных файлов. Если файл повреждён или другой версии, бросает std::runtime_error,
+    // индекс не меняется.
+    std::vector<SourceFile> Load(const std::string& path);
+
+
+    // Текущий снимок индекса; остаётся действительным, пока на него есть ссылка
+    std::shared_ptr<const IndexSnapshot> Snapshot() const { return std::atomic_load(&current); }
+
+
+    // Число документов в индексе без учёта удалённых
+    size_t GetDocumentCount() const { return Snapshot()->GetDocumentCount(); }
+
+
     std::vector<Entry> GetWordCount(const std::string& word);
 
 private:
-    std::vector<std::string> docs; // список содержимого документов
-    std::map<std::string, std::vector<Entry>> freq_dictionary; // частотный словарь
+    std::shared_ptr<const IndexSnapshot> current = std::make_shared<IndexSnapshot>(); // только через atomic_load/atomic_store
+    std::shared_ptr<IndexSnapshot> working; // изменяемая копия, ещё не опубликованная
+    std::recursive_mutex update_mutex; // изменения индекса выполняются по одному
+    size_t batch_depth = 0;
+
     std::mutex freq_dictionary_mutex; // мьютекс для безопасной работы с частотным словарем
+    ThreadPool* pool = nullptr; // пул для индексации, по умолчанию общий
+    BuildMode build_mode = BuildMode::Sharded;
+    size_t memory_budget = size_t(1) << 30;
+    std::string temp_directory;
+    bool store_positions = false;
+
+    // Часть словаря одного куска документов, относящаяся к одному шарду
+    struct LocalDictionary {
+        // Вхождение слова в документ куска, по порядку документов и слов в них
+        struct Occurrence {
+            uint32_t id;
+            uint32_t position;
+        };
+
+        TermDictionary terms;
+        std::vector<std::vector<Entry>> postings;
+        std::vector<Occurrence> occurrences; // заполняется, если with_positions, до GroupPositions
+        std::vector<uint32_t> positions; // позиции вхождений, сгруппированные по терминам
+        std::vector<uint32_t> position_starts; // начало позиций термина в positions, последний - конец
+        bool with_positions = false;
+
+
+        uint32_t Find(std::string_view term, uint64_t hash) {
+            uint32_t id = terms.Insert(term, hash);
+            if (id == postings.size()) {
+                postings.emplace_back();
+            }
+            return id;
+        }
+
+
+        // Учитывает вхождение термина на позиции position; документы должны поступать по возрастанию doc_id
+        void AddOccurrence(std::string_view term, uint64_t hash, size_t doc_id, uint32_t position) {
+            uint32_t id = Find(term, hash);
+            auto& entries = postings[id];
+            if (entries.empty() || entries.back().doc_id != doc_id) {
+                entries.push_back({doc_id, 1});
+            } else {
+                ++entries.back().count;
+            }
+            if (with_positions) {
+                occurrences.push_back({id, position});
+            }
+        }
+
+
+        // Раскладывает позиции куска по терминам (по 4 байта на вхождение вместо 8)
+        void GroupPositions() {
+            position_starts.assign(postings.size() + 1, 0);
+            for (const auto& occurrence : occurrences) {
+                ++position_starts[occurrence.id + 1];
+            }
+            for (size_t id = 0; id < postings.size(); ++id) {
+                position_starts[id + 1] += position_starts[id];
+            }
+
+            std::vector<uint32_t> next(position_starts.begin(), position_starts.end() - 1);
+            positions.resize(occurrences.size());
+            for (const auto& occurrence : occurrences) {
+                positions[next[occurrence.id]++] = occurrence.position;
+            }
+            std::vector<Occurrence>().swap(occurrences);
+        }
+    };
+
+
+    // Строят словарь target и списки вхождений postings по идентификатору термина
+    void BuildLocked(ThreadPool& workers, const std::vector<std::string_view>& docs, IndexSnapshot& target,
+                     std::vector<PostingList>& postings);
+
+
+    // Позиции слов, если они хранятся, собираются тем же проходом по документам
+    void BuildSharded(ThreadPool& workers, const std::vector<std::string_view>& docs, IndexSnapshot& target,
+                      std::vector<PostingList>& postings, std::vector<PositionList>& positions);
+
+
+    // Вторым проходом по документам собирает позиции вхождений уже построенных списков.
+    // Нужен режиму Locked: в нём документы попадают в списки не по порядку doc_id.
+    void BuildPositions(ThreadPool& workers, const std::vector<std::string_view>& docs, const IndexSnapshot& target,
+                        const std::vector<PostingList>& postings, std::vector<PositionList>& positions);
+
+
+    // Строит сегмент во временном файле через SpimiBuilder и открывает его
+    void BuildExternal(const DocumentSource& source);
+
+
+    // Возвращает число слов документа
+    size_t IndexDocument(size_t doc_id, std::string_view content, Tokenizer& tokenizer,
+                         TermDictionary& dictionary, std::vector<std::vector<Entry>>& lists);
+
+
+    static void ResetDocumentIds(IndexSnapshot& target, size_t doc_count);
+
+
+    // Считает нормы длины документов по числу слов в них
+    static void SetDocumentLengths(IndexSnapshot& target, const std::vector<uint32_t>& lengths);
+
+
+    // Идентификатор термина в снимке; новый термин добавляется в target.added_terms
+    static uint32_t InsertTerm(IndexSnapshot& target, std::string_view term);
+
+
+    // Общий словарь снимка вместе с добавленными терминами
+    static std::shared_ptr<TermDictionary> MergedDictionary(const IndexSnapshot& source);
+
+
+    // Изменяемая копия текущего снимка
+    IndexSnapshot& Edit();
 
 
-    void IndexDocument(size_t doc_id, const std::string& content);
+    // Публикует изменённую копию, если пакет изменений не открыт
+    void FinishEdit();
 
 
-    std::vector<std::string> SplitIntoWords(const std::string& text);
+    void CompactSnapshot(IndexSnapshot& target);
 };
\ No newline at end of file
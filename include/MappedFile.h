@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+
+// Файл, отображённый в память только для чтения. Страницы подгружаются
+// операционной системой при первом обращении, поэтому открытие не зависит
+// от размера файла. Ошибки открытия сообщаются исключением std::runtime_error.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+
+
+    ~MappedFile();
+
+
+    MappedFile(const MappedFile&) = delete;
+
+
+    MappedFile& operator=(const MappedFile&) = delete;
+
+
+    const char* Data() const { return data; }
+
+
+    size_t Size() const { return size; }
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* file_handle = nullptr;
+    void* mapping_handle = nullptr;
+#endif
+};
\ No newline at end of file
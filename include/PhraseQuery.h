@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Tokenizer.h"
+
+
+// Позиционное условие запроса над словами ParsedQuery::ConstraintWords()[first, first + length)
+struct PositionConstraint {
+    uint32_t first;
+    uint32_t length;
+    uint32_t distance; // 0 - фраза (слова подряд), иначе NEAR/distance для двух слов
+};
+
+
+// Запрос с фразами и условиями близости. Слова в кавычках образуют фразу:
+// "new york" находит документы, где york стоит сразу после new. Оператор NEAR/k
+// между двумя словами вне кавычек требует, чтобы они стояли не дальше k слов
+// друг от друга в любом порядке: coffee NEAR/3 milk. Все слова, кроме операторов,
+// остаются обычными словами запроса. Буферы переиспользуются между вызовами Parse.
+class ParsedQuery {
+public:
+    // Слова действительны до следующего вызова tokenizer.Tokenize
+    void Parse(std::string_view query, Tokenizer& tokenizer);
+
+
+    // Слова запроса по порядку, без операторов NEAR
+    const std::vector<std::string_view>& Words() const { return words; }
+
+
+    const std::vector<PositionConstraint>& Constraints() const { return constraints; }
+
+
+    const std::vector<std::string_view>& ConstraintWords() const { return constraint_words; }
+
+private:
+    std::string text; // запрос с кавычками, заменёнными пробелами
+    std::vector<size_t> quotes; // смещения кавычек
+    std::vector<std::string_view> words;
+    std::vector<PositionConstraint> constraints;
+    std::vector<std::string_view> constraint_words;
+};
+
+
+// Есть ли позиция p, для которой слово i фразы стоит на позиции p + i.
+// positions[i] - позиции i-го слова фразы в документе по возрастанию.
+bool MatchPhrase(const std::vector<uint32_t>* const* positions, size_t length);
+
+
+// Есть ли вхождения двух слов на разных позициях не дальше distance друг от друга
+bool MatchNear(const std::vector<uint32_t>& first, const std::vector<uint32_t>& second, uint32_t distance);
\ No newline at end of file
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "PostingList.h"
+
+
+// Позиции вхождений термина (номера слов в документе), хранятся отдельно от списка
+// вхождений, поэтому запросы без фраз их не читают. Позиции каждого вхождения записаны
+// подряд в varint (первая как есть, остальные разностями) в порядке вхождений PostingList.
+// Для каждой группы из group_size вхождений хранится смещение её первой позиции, а нужное
+// вхождение внутри группы находится по частотам блока, которые уже распаковал курсор.
+// Как и у PostingList, копии разделяют данные; изменяемая копия сначала получает свои.
+class PositionList {
+public:
+    static constexpr size_t block_size = PostingList::block_size;
+
+
+    // Меньше группа - короче пропуск до вхождения, но больше смещений (8 байт на группу)
+    static constexpr size_t group_size = 16;
+    static_assert(block_size % group_size == 0, "group must not cross posting blocks");
+
+
+    // Число групп в списке из size вхождений
+    static size_t GroupsFor(size_t size) { return (size + group_size - 1) / group_size; }
+
+
+    // Место, до которого дочитана группа: курсоры идут по возрастанию doc_id, поэтому
+    // следующее вхождение той же группы читается с него, а не с начала группы
+    struct ReadPosition {
+        size_t group = SIZE_MAX;
+        size_t posting = 0; // номер следующего непрочитанного вхождения в списке
+        uint64_t offset = 0;
+    };
+
+
+    PositionList() = default;
+
+
+    // Позиции поверх готовых данных без копирования. offsets[i] - смещение группы i
+    // от base, данные термина занимают [offsets[0], end). size - число вхождений.
+    static PositionList Attach(const uint64_t* offsets, size_t group_count, const uint8_t* base,
+                               uint64_t end, size_t size);
+
+
+    // Дописывает позиции следующего вхождения списка, positions по возрастанию
+    void Append(const uint32_t* positions, size_t count);
+
+
+    // Число вхождений
+    size_t Size() const { return size; }
+
+
+    size_t GroupCount() const { return group_count; }
+
+
+    // Смещение первой позиции группы от начала данных термина
+    uint64_t GroupOffset(size_t group) const { return offsets[group] - offset_base; }
+
+
+    const uint8_t* Data() const { return data; }
+
+
+    size_t DataSize() const { return data_size; }
+
+
+    // Позиции вхождения index блока block; counts - частоты вхождений этого блока
+    void Read(size_t block, size_t index, const uint32_t* counts, std::vector<uint32_t>& positions) const;
+
+
+    // То же, продолжая с места предыдущего чтения from (оно обновляется)
+    void Read(size_t block, size_t index, const uint32_t* counts, std::vector<uint32_t>& positions,
+              ReadPosition& from) const;
+
+
+    size_t MemoryUsage() const;
+
+
+    // Дописывает в out позиции одного вхождения в формате списка
+    static void Encode(const uint32_t* positions, size_t count, std::vector<uint8_t>& out);
+
+private:
+    struct Storage {
+        std::vector<uint64_t> offsets;
+        std::vector<uint8_t> data;
+    };
+
+    std::shared_ptr<Storage> storage; // собственные данные, nullptr - подключённые или пустой список
+    const uint64_t* offsets = nullptr;
+    const uint8_t* data = nullptr;
+    uint64_t offset_base = 0; // смещение данных термина в подключённой области
+    size_t group_count = 0;
+    size_t data_size = 0;
+    size_t size = 0;
+
+
+    Storage& MakeWritable();
+
+
+    void Sync();
+};
\ No newline at end of file
@@ -0,0 +1,293 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <vector>
+#include "BitPacking.h"
+
+
+struct Entry {
+    size_t doc_id, count;
+    // Данный оператор необходим для проведения тестовых сценариев
+    bool operator ==(const Entry& other) const {
+        return (doc_id == other.doc_id &&
+                count == other.count);
+    }
+};
+
+
+// Заголовок блока сжатого списка вхождений
+struct PostingBlock {
+    uint32_t last_doc;   // последний doc_id блока, позволяет пропускать блоки без распаковки
+    uint32_t offset;     // начало упакованных данных блока (в 32-битных словах)
+    uint32_t max_count;  // наибольшая частота в блоке, верхняя граница при отсечении документов
+    uint8_t doc_bits;    // разрядность разностей doc_id
+    uint8_t count_bits;  // разрядность (count - 1)
+    uint16_t size;       // число вхождений в блоке
+};
+
+
+// Сжатый список вхождений термина: doc_id по возрастанию хранятся разностями,
+// разности и частоты упакованы блоками по 128 с минимальной разрядностью.
+// Копии списка разделяют упакованные данные; изменяемая копия сначала получает свои.
+class PostingList {
+public:
+    static constexpr size_t block_size = BitPacking::block_size;
+
+
+    PostingList() = default;
+
+
+    // entries должны быть упорядочены по doc_id
+    explicit PostingList(const std::vector<Entry>& entries);
+
+
+    // Список поверх готовых блоков (например, отображённых в память) без копирования.
+    // Память должна жить дольше списка и его копий; при первом изменении данные копируются.
+    static PostingList Attach(const PostingBlock* block_data, size_t block_count,
+                              const uint32_t* word_data, size_t word_count, size_t size, uint32_t max_count);
+
+
+    // Добавляет вхождение в конец списка, doc_id должен быть больше всех имеющихся
+    void Append(uint32_t doc_id, uint32_t count);
+
+
+    size_t Size() const { return size; }
+
+
+    bool Empty() const { return size == 0; }
+
+
+    size_t BlockCount() const { return block_count; }
+
+
+    const PostingBlock& Block(size_t index) const { return block_data[index]; }
+
+
+    // Наибольшая частота во всём списке; хранится вместе со списком, заголовки блоков не читаются
+    uint32_t MaxCount() const { return max_count; }
+
+
+    const PostingBlock* BlockData() const { return block_data; }
+
+
+    // Упакованные данные всех блоков
+    const uint32_t* WordData() const { return word_data; }
+
+
+    size_t WordCount() const { return word_count; }
+
+
+    // Распаковывает блок: doc_ids и counts должны вмещать block_size значений.
+    // Возвращает число вхождений в блоке.
+    size_t DecodeBlock(size_t index, uint32_t* doc_ids, uint32_t* counts) const;
+
+
+    // Проверяет подключённый список перед чтением: заголовки блоков не выходят за данные,
+    // doc_id строго возрастают и меньше document_count, частоты не превышают max_count.
+    // Распаковывает все блоки списка.
+    bool IsWellFormed(size_t document_count) const;
+
+
+    // Размер списка в памяти, включая подключённые данные
+    size_t MemoryUsage() const;
+
+
+    // Упаковывает block_length <= block_size вхождений в один блок. previous_doc - последний
+    // doc_id предыдущего блока (0 для первого), поле offset заполняет вызывающий.
+    // out должен вмещать max_block_words слов. Возвращает число записанных слов.
+    static size_t EncodeBlock(const uint32_t* doc_ids, const uint32_t* counts, size_t block_length,
+                              uint32_t previous_doc, PostingBlock& block, uint32_t* out);
+
+
+    static constexpr size_t max_block_words = 2 * BitPacking::PackedWords(32);
+
+private:
+    struct Storage {
+        std::vector<PostingBlock> blocks;
+        std::vector<uint32_t> data; // упакованные блоки подряд
+    };
+
+    std::shared_ptr<Storage> storage; // собственные данные, nullptr - подключённые или пустой список
+    const PostingBlock* block_data = nullptr; // блоки из storage или подключённой памяти
+    const uint32_t* word_data = nullptr;
+    uint32_t block_count = 0;
+    uint32_t word_count = 0;
+    uint32_t size = 0;
+    uint32_t max_count = 0;
+
+
+    // Делает данные собственными и не разделёнными с другими копиями
+    Storage& MakeWritable();
+
+
+    // Обновляет указатели на данные после изменения storage
+    void Sync();
+
+
+    void AppendBlock(const uint32_t* doc_ids, const uint32_t* counts, size_t block_length);
+};
+
+
+// Битовая карта удалённых документов (по одному биту на doc_id)
+inline bool IsDocumentDeleted(const uint64_t* deleted, uint32_t doc_id) {
+    return deleted && ((deleted[doc_id >> 6] >> (doc_id & 63)) & 1);
+}
+
+
+// Курсор по сжатому списку: распаковывает по одному блоку во внутренний буфер
+// и не выделяет память. AdvanceTo пропускает блоки по заголовкам, не распаковывая их.
+// Документы, отмеченные в битовой карте deleted, пропускаются.
+class PostingCursor {
+public:
+    // Пустой курсор, сразу находится в конце
+    PostingCursor() = default;
+
+
+    explicit PostingCursor(const PostingList& list, const uint64_t* deleted = nullptr)
+            : list(&list), deleted(deleted) {
+        LoadBlock(0);
+        SkipDeleted();
+    }
+
+
+    bool AtEnd() const { return position >= length; }
+
+
+    uint32_t DocId() const { return doc_ids[position]; }
+
+
+    uint32_t Count() const { return counts[position]; }
+
+
+    void Next() {
+        if (++position == length) {
+            LoadBlock(block + 1);
+        }
+        if (deleted) {
+            SkipDeleted();
+        }
+    }
+
+
+    // Переходит к первому вхождению с doc_id >= target
+    void AdvanceTo(uint32_t target);
+
+
+    // Позиция вхождения в списке, нужна для сравнения итераторов
+    size_t Offset() const { return block * PostingList::block_size + position; }
+
+
+    // Блок текущего вхождения, его номер в блоке и частоты блока - для чтения позиций
+    size_t BlockIndex() const { return block; }
+
+
+    size_t BlockPosition() const { return position; }
+
+
+    const uint32_t* BlockCounts() const { return counts; }
+
+private:
+    const PostingList* list = nullptr;
+    const uint64_t* deleted = nullptr;
+    size_t block = 0;
+    size_t position = 0;
+    size_t length = 0;
+    uint32_t doc_ids[PostingList::block_size];
+    uint32_t counts[PostingList::block_size];
+
+
+    bool IsDeleted(uint32_t doc_id) const { return IsDocumentDeleted(deleted, doc_id); }
+
+
+    void SkipDeleted();
+
+
+    void LoadBlock(size_t index);
+};
+
+
+// Представление списка вхождений только для чтения, без копирования.
+// Действует, пока индекс не изменён. Итерация пропускает удалённые документы
+// и возвращает внешние номера документов (external_ids == nullptr - номера совпадают).
+class PostingsView {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Entry;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Entry*;
+        using reference = Entry;
+
+
+        Iterator() = default;
+
+
+        Iterator(const PostingList& list, const uint64_t* deleted, const uint32_t* external_ids)
+                : cursor(list, deleted), external_ids(external_ids) {}
+
+
+        Entry operator*() const {
+            uint32_t doc_id = cursor.DocId();
+            return {external_ids ? external_ids[doc_id] : doc_id, cursor.Count()};
+        }
+
+
+        Iterator& operator++() {
+            cursor.Next();
+            return *this;
+        }
+
+
+        bool operator==(const Iterator& other) const {
+            if (cursor.AtEnd() || other.cursor.AtEnd()) {
+                return cursor.AtEnd() == other.cursor.AtEnd();
+            }
+            return cursor.Offset() == other.cursor.Offset();
+        }
+
+
+        bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+    private:
+        PostingCursor cursor;
+        const uint32_t* external_ids = nullptr;
+    };
+
+
+    PostingsView() = default;
+
+
+    explicit PostingsView(const PostingList& list, const uint64_t* deleted = nullptr,
+                          const uint32_t* external_ids = nullptr)
+            : list(&list), deleted(deleted), external_ids(external_ids) {}
+
+
+    // Длина списка, включая удалённые документы, которые ещё не вычищены из него
+    size_t Size() const { return list ? list->Size() : 0; }
+
+
+    bool Empty() const { return Size() == 0; }
+
+
+    Iterator begin() const { return list ? Iterator(*list, deleted, external_ids) : Iterator(); }
+
+
+    Iterator end() const { return Iterator(); }
+
+
+    // Курсор по внутренним номерам документов
+    PostingCursor Cursor() const { return list ? PostingCursor(*list, deleted) : PostingCursor(); }
+
+
+    // Сам список (nullptr - слова нет) для поблочной обработки по внутренним номерам
+    const PostingList* List() const { return list; }
+
+private:
+    const PostingList* list = nullptr;
+    const uint64_t* deleted = nullptr;
+    const uint32_t* external_ids = nullptr;
+};
\ No newline at end of file
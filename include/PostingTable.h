@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "IndexSegment.h"
+#include "PositionList.h"
+#include "PostingList.h"
+
+
+// Списки вхождений и позиции по идентификатору термина, кусками по chunk_size терминов.
+// Копии таблицы разделяют куски; изменяемый кусок сначала копируется, поэтому правка
+// копии снимка не трогает опубликованный снимок и копирует только куски своих терминов.
+// У таблицы, подключённой к сегменту, кусок собирается из TermList при первом обращении
+// к его терминам: открытие сегмента не проходит по всем терминам.
+class PostingTable {
+public:
+    static constexpr size_t chunk_size = 256;
+
+
+    struct Chunk {
+        std::vector<PostingList> postings;
+        std::vector<PositionList> positions; // пусто, если таблица без позиций
+    };
+
+
+    PostingTable() = default;
+
+
+    // Таблица из готовых списков; positions пуст или той же длины, что postings
+    PostingTable(std::vector<PostingList> postings, std::vector<PositionList> positions, bool with_positions);
+
+
+    // Куски, собранные читателями у опубликованного снимка, копируются атомарно
+    PostingTable(const PostingTable& other);
+
+
+    PostingTable& operator=(const PostingTable& other);
+
+
+    PostingTable(PostingTable&&) = default;
+
+
+    PostingTable& operator=(PostingTable&&) = default;
+
+
+    // Таблица поверх секций сегмента без их чтения. Отображение должно жить дольше таблицы;
+    // списки куска проверяются при его сборке, повреждённые - std::runtime_error.
+    static PostingTable Attach(const IndexSegment::Reader& reader, size_t term_count);
+
+
+    size_t Size() const { return size; }
+
+
+    bool HasPositions() const { return with_positions; }
+
+
+    // Задаёт хранение позиций у пустой таблицы
+    void SetPositions(bool enabled) { with_positions = enabled; }
+
+
+    const PostingList& Postings(uint32_t id) const { return GetChunk(id / chunk_size).postings[id % chunk_size]; }
+
+
+    const PositionList& Positions(uint32_t id) const { return GetChunk(id / chunk_size).positions[id % chunk_size]; }
+
+
+    // Списки термина для изменения; кусок, разделённый с другими копиями, копируется.
+    // Разные потоки могут менять термины только разных кусков.
+    PostingList& MutablePostings(uint32_t id) { return MutableChunk(id / chunk_size).postings[id % chunk_size]; }
+
+
+    PositionList& MutablePositions(uint32_t id) { return MutableChunk(id / chunk_size).positions[id % chunk_size]; }
+
+
+    // Добавляет термин с пустыми списками и возвращает его идентификатор
+    uint32_t Add();
+
+
+    size_t ChunkCount() const { return chunks.size(); }
+
+
+    // Кусок для обхода всей таблицы: ещё не собранный из сегмента собирается временно
+    // и в таблице не остаётся, чтобы обход не держал в памяти все списки
+    std::shared_ptr<const Chunk> ReadChunk(size_t index) const;
+
+private:
+    // Секции сегмента, из которых собираются куски
+    struct Segment {
+        size_t term_count;
+        size_t document_count;
+        const IndexSegment::TermList* lists;
+        const PostingBlock* blocks;
+        size_t block_total;
+        const uint32_t* words;
+        size_t word_total;
+        const uint64_t* position_offsets;
+        size_t group_total;
+        const uint8_t* position_data;
+        uint64_t position_size;
+    };
+
+    // nullptr - кусок ещё не собран из сегмента. Куски опубликованного снимка
+    // собираются читателями, поэтому элементы читаются и пишутся атомарно.
+    mutable std::vector<std::shared_ptr<Chunk>> chunks;
+    std::shared_ptr<const Segment> segment;
+    size_t size = 0;
+    bool with_positions = false;
+
+
+    const Chunk& GetChunk(size_t index) const;
+
+
+    Chunk& MutableChunk(size_t index);
+
+
+    std::shared_ptr<Chunk> BuildChunk(size_t index) const;
+};
\ No newline at end of file
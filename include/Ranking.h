@@ -0,0 +1,82 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "IndexSnapshot.h"
+#include "PostingList.h"
+
+
+// Политики ранжирования для вычислителей SearchServer. Политика передаётся параметром
+// шаблона, поэтому оценка вхождения встраивается во внутренний цикл. Prepare вызывается
+// один раз для каждого слова запроса, Score - для каждого вхождения, Bound даёт верхнюю
+// границу Score по наибольшей частоте (блока или всего списка) для отсечения документов.
+
+
+// Сумма частот слов запроса в документе
+class SumRanking {
+public:
+    struct Term {};
+
+
+    explicit SumRanking(const IndexSnapshot&) {}
+
+
+    Term Prepare(const PostingList&) const { return {}; }
+
+
+    float Score(const Term&, uint32_t, uint32_t count) const { return static_cast<float>(count); }
+
+
+    float Bound(const Term&, uint32_t max_count) const { return static_cast<float>(max_count); }
+};
+
+
+// Okapi BM25. Длина документа учитывается через заранее посчитанную норму
+// (длина / средняя длина), поэтому на вхождение приходится одно чтение из массива.
+class Bm25Ranking {
+public:
+    static constexpr float k1 = 1.2f;
+    static constexpr float b = 0.75f;
+
+
+    struct Term {
+        float weight; // idf * (k1 + 1)
+    };
+
+
+    explicit Bm25Ranking(const IndexSnapshot& snapshot)
+            : norms(snapshot.DocumentNorms()),
+              document_count(static_cast<double>(snapshot.GetDocumentCount())),
+              minimum_length_factor(length_base + length_scale * snapshot.MinimumNorm()) {}
+
+
+    Term Prepare(const PostingList& list) const {
+        // Длина списка включает ещё не вычищенные удалённые документы, idf не должен стать отрицательным
+        auto frequency = static_cast<double>(list.Size());
+        double idf = std::max(0.0, std::log(1.0 + (document_count - frequency + 0.5) / (frequency + 0.5)));
+        return {static_cast<float>(idf * (k1 + 1))};
+    }
+
+
+    float Score(const Term& term, uint32_t doc_id, uint32_t count) const {
+        auto frequency = static_cast<float>(count);
+        return term.weight * frequency / (frequency + length_base + length_scale * norms[doc_id]);
+    }
+
+
+    // Самый короткий документ коллекции даёт наибольший вклад; запас покрывает ошибки округления
+    float Bound(const Term& term, uint32_t max_count) const {
+        auto frequency = static_cast<float>(max_count);
+        return term.weight * frequency / (frequency + minimum_length_factor) * bound_margin;
+    }
+
+private:
+    static constexpr float length_base = k1 * (1 - b);
+    static constexpr float length_scale = k1 * b;
+    static constexpr float bound_margin = 1.0001f;
+
+    const float* norms;
+    double document_count;
+    float minimum_length_factor;
+};
\ No newline at end of file
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+// Частотный эскиз TinyLFU: count-min sketch из четырёх строк счётчиков до 15.
+// Когда добавлений набирается в 10 раз больше ширины строки, все счётчики делятся
+// пополам, поэтому эскиз помнит недавнюю популярность, а не всю историю.
+class FrequencySketch {
+public:
+    // width - число счётчиков в строке, округляется вверх до степени двойки
+    explicit FrequencySketch(size_t width);
+
+
+    void Increment(uint64_t hash);
+
+
+    // Оценка частоты сверху: наименьший из четырёх счётчиков
+    uint32_t Estimate(uint64_t hash) const;
+
+private:
+    static constexpr size_t rows = 4;
+    static constexpr uint8_t max_count = 15;
+
+    std::vector<uint8_t> counters; // rows строк подряд
+    uint32_t index_shift = 0;      // 64 - log2(ширины строки)
+    size_t additions = 0;
+    size_t sample_size = 0;
+
+
+    size_t Index(uint64_t hash, size_t row) const;
+
+
+    void Age();
+};
+
+
+// Счётчики кэша результатов (суммы по всем шардам)
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t insertions = 0;
+    uint64_t rejections = 0;    // не допущены TinyLFU или больше шарда
+    uint64_t evictions = 0;
+    uint64_t invalidations = 0; // записи, сброшенные при смене поколения индекса
+    size_t entries = 0;
+    size_t memory = 0;
+    size_t capacity = 0;
+};
+
+
+// Потокобезопасный кэш значений по строковому ключу с ограничением по памяти.
+// Ключи распределены по шардам с отдельными мьютексами. Внутри шарда записи
+// вытесняются по LRU, а новая запись допускается, только если по эскизу
+// TinyLFU её ключ запрашивали чаще, чем ключ вытесняемой записи: редкие
+// запросы не вымывают популярные.
+// Каждая запись относится к поколению индекса: обращение с более новым
+// поколением очищает шард, а обращения со старым снимком кэш не используют.
+template <typename Value>
+class ResultCache {
+public:
+    // capacity - ограничение памяти в байтах на все шарды вместе
+    explicit ResultCache(size_t capacity, size_t shard_count = 16) : capacity(capacity) {
+        shard_capacity = capacity / shard_count;
+        shards.reserve(shard_count);
+        for (size_t i = 0; i < shard_count; ++i) {
+            shards.push_back(std::make_unique<Shard>(shard_capacity / 128));
+        }
+    }
+
+
+    // Копирует значение в value и возвращает true, если ключ есть в кэше
+    bool Find(const std::string& key, uint64_t generation, Value& value) {
+        uint64_t hash = std::hash<std::string_view>()(key);
+        Shard& shard = ShardFor(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        shard.sketch.Increment(hash);
+        auto found = Synchronize(shard, generation) ? shard.lookup.find(key) : shard.lookup.end();
+        if (found == shard.lookup.end()) {
+            ++shard.stats.misses;
+            return false;
+        }
+
+        shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+        value = found->second->value;
+        ++shard.stats.hits;
+        return true;
+    }
+
+
+    // bytes - память, занимаемая значением вне самого объекта Value
+    void Insert(const std::string& key, uint64_t generation, const Value& value, size_t bytes) {
+        uint64_t hash = std::hash<std::string_view>()(key);
+        Shard& shard = ShardFor(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        if (!Synchronize(shard, generation) || shard.lookup.count(key) > 0) {
+            return;
+        }
+
+        size_t cost = bytes + key.size() + entry_overhead;
+        if (cost > shard_capacity) {
+            ++shard.stats.rejections;
+            return;
+        }
+
+        // Решение о допуске принимается по самой давней записи, остальные вытесняются без сравнения
+        if (shard.memory + cost > shard_capacity) {
+            const Node& victim = shard.entries.back();
+            if (shard.sketch.Estimate(hash) <= shard.sketch.Estimate(std::hash<std::string_view>()(victim.key))) {
+                ++shard.stats.rejections;
+                return;
+            }
+        }
+        while (shard.memory + cost > shard_capacity) {
+            Evict(shard);
+            ++shard.stats.evictions;
+        }
+
+        shard.entries.push_front(Node{key, value, cost});
+        shard.lookup.emplace(shard.entries.front().key, shard.entries.begin());
+        shard.memory += cost;
+        ++shard.stats.insertions;
+    }
+
+
+    void Clear() {
+        for (auto& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            shard->lookup.clear();
+            shard->entries.clear();
+            shard->memory = 0;
+        }
+    }
+
+
+    CacheStats Stats() const {
+        CacheStats total;
+        total.capacity = capacity;
+        for (const auto& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            total.hits += shard->stats.hits;
+            total.misses += shard->stats.misses;
+            total.insertions += shard->stats.insertions;
+            total.rejections += shard->stats.rejections;
+            total.evictions += shard->stats.evictions;
+            total.invalidations += shard->stats.invalidations;
+            total.entries += shard->entries.size();
+            total.memory += shard->memory;
+        }
+        return total;
+    }
+
+private:
+    // Приблизительные накладные расходы записи: узлы списка и хеш-таблицы
+    static constexpr size_t entry_overhead = 96 + sizeof(Value);
+
+    struct Node {
+        std::string key;
+        Value value;
+        size_t cost;
+    };
+
+    struct Shard {
+        explicit Shard(size_t sketch_width) : sketch(sketch_width) {}
+
+        mutable std::mutex mutex;
+        std::list<Node> entries; // от недавно использованных к давним
+        std::unordered_map<std::string_view, typename std::list<Node>::iterator> lookup; // ключи - строки из entries
+        FrequencySketch sketch;
+        uint64_t generation = 0;
+        size_t memory = 0;
+        CacheStats stats;
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    size_t capacity;
+    size_t shard_capacity;
+
+
+    Shard& ShardFor(uint64_t hash) {
+        // старшие биты: младшие уже использованы эскизом и хеш-таблицей
+        return *shards[(hash >> 48) % shards.size()];
+    }
+
+
+    // Сбрасывает шард, если индекс с тех пор изменился.
+    // Возвращает false для обращений по снимку старше содержимого шарда.
+    bool Synchronize(Shard& shard, uint64_t generation) {
+        if (generation < shard.generation) {
+            return false;
+        }
+        if (generation > shard.generation) {
+            shard.stats.invalidations += shard.entries.size();
+            shard.lookup.clear();
+            shard.entries.clear();
+            shard.memory = 0;
+            shard.generation = generation;
+        }
+        return true;
+    }
+
+
+    void Evict(Shard& shard) {
+        Node& victim = shard.entries.back();
+        shard.memory -= victim.cost;
+        shard.lookup.erase(victim.key);
+        shard.entries.pop_back();
+    }
+};
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "InvertedIndex.h"
+#include "ResultCache.h"
 #include <vector>
 #include <string>
 #include <map>
@@ -16,20 +17,149 @@ struct RelativeIndex {
 };
 
 
+// Способ отбора лучших документов запроса; результаты у всех способов одинаковые
+enum class EvaluationStrategy {
+    Exhaustive, // пересечение списков целиком и оценка каждого общего документа
+    Daat,       // документ за документом по курсорам всех слов без отсечения
+    BlockMax    // документ за документом с отсечением по наибольшим частотам блоков (Block-Max WAND)
+};
+
+
+// Формула релевантности документа (см. Ranking.h)
+enum class RankingModel {
+    Sum, // сумма частот слов запроса
+    Bm25 // Okapi BM25 с учётом длины документа
+};
+
+
+// Сколько слов запроса должен содержать документ
+enum class MatchMode {
+    All,    // все слова
+    Any,    // хотя бы одно слово
+    AtLeast // не меньше заданного числа слов
+};
+
+
+// Способ пересечения списков всех слов в режиме exhaustive
+enum class IntersectionMethod {
+    Auto,   // выбирает планировщик по оценке стоимости
+    Merge,  // слияние блоков (SIMD): списки близкой длины
+    Gallop, // экспоненциальный поиск кандидатов в блоках длинных списков
+    Bitmap  // накопление по диапазонам номеров в плоских массивах: плотные списки
+};
+
+
+// Слово запроса после планирования. Слово ищется в словаре один раз,
+// статистика берётся из заголовка списка без чтения блоков.
+struct PlannedTerm {
+    uint32_t word;             // номер в отсортированном списке различных слов запроса
+    uint32_t term_id;
+    size_t document_frequency; // длина списка, включая ещё не вычищенные удалённые документы
+    uint32_t max_count;        // наибольшая частота слова в документе
+    float max_score;           // верхняя граница оценки слова при выбранном ранжировании
+};
+
+
+// План запроса: слова с вхождениями в порядке обработки и способ вычисления
+struct QueryPlan {
+    std::vector<PlannedTerm> terms;   // по возрастанию длины списков
+    std::vector<uint32_t> missing;    // слова без вхождений (номера, как в PlannedTerm::word)
+    size_t minimum = 0;               // сколько слов должен содержать документ
+    bool empty = false;               // результат заведомо пуст, списки не обходятся
+    bool positional = false;          // проверяются фразы и NEAR
+    EvaluationStrategy strategy = EvaluationStrategy::BlockMax;
+    IntersectionMethod method = IntersectionMethod::Merge; // для exhaustive, кроме Auto
+    double estimated_matches = 0;     // ожидаемое число документов с нужными словами
+    double estimated_cost = 0;        // ожидаемое время выбранного способа, нс
+};
+
+
+// План запроса для команды explain вместе со словами, на которые он ссылается
+struct QueryExplanation {
+    std::vector<std::string> words;       // различные слова запроса по алфавиту
+    std::vector<std::string> constraints; // фразы и NEAR так, как записаны в запросе
+    QueryPlan plan;
+};
+
+
+// Буферы обработчика запросов (определены в SearchServer.cpp)
+struct QueryScratch;
+
+
 class SearchServer {
 public:
 
     SearchServer(InvertedIndex& idx) : _index(idx) {};
 
 
-    std::vector<std::vector<RelativeIndex>> search(const std::vector<std::string>& queries_input);
+    // Пакеты запросов выполняются на пуле pool, по умолчанию - на общем
+    SearchServer(InvertedIndex& idx, ThreadPool& pool) : _index(idx), _pool(&pool) {};
+
+
+    void SetStrategy(EvaluationStrategy strategy) { _strategy = strategy; }
+
+
+    void SetRanking(RankingModel ranking) { _ranking = ranking; }
+
+
+    // Способ пересечения в режиме exhaustive; Auto - по оценке стоимости для каждого запроса
+    void SetIntersection(IntersectionMethod method) { _intersection = method; }
+
+
+    // minimum_terms учитывается в режиме AtLeast; если в запросе меньше разных слов, нужны все
+    void SetMatchMode(MatchMode mode, size_t minimum_terms = 1) {
+        _match = mode;
+        _minimum_match = minimum_terms;
+    }
+
+
+    // Число обработчиков пакета запросов, 0 - по числу потоков пула, 1 - последовательно
+    void SetParallelism(size_t workers) { _parallelism = workers; }
+
+
+    // Кэш результатов запросов размером bytes байт, 0 - без кэша. Ключ - набор
+    // слов запроса без повторов и лимит; при изменении индекса кэш сбрасывается.
+    void SetCacheCapacity(size_t bytes);
+
+
+    // Счётчики кэша (нулевые, если кэш отключён)
+    CacheStats GetCacheStats() const;
+
+
+    // План запроса по текущему индексу без его выполнения
+    QueryExplanation Explain(const std::string& query) const;
+
+
+    // Для каждого запроса возвращает не более limit документов (0 - все),
+    // упорядоченных по убыванию релевантности, при равенстве - по doc_id.
+    // Запросы пакета выполняются параллельно, ответы - в порядке запросов.
+    // Фразы в кавычках и NEAR/k проверяются, если индекс хранит позиции (PhraseQuery.h).
+    std::vector<std::vector<RelativeIndex>> search(const std::vector<std::string>& queries_input, size_t limit = 0);
 
 private:
     InvertedIndex& _index;
+    EvaluationStrategy _strategy = EvaluationStrategy::BlockMax;
+    RankingModel _ranking = RankingModel::Sum;
+    IntersectionMethod _intersection = IntersectionMethod::Auto;
+    MatchMode _match = MatchMode::All;
+    size_t _minimum_match = 1;
+    ThreadPool* _pool = nullptr;
+    size_t _parallelism = 0;
+    std::unique_ptr<ResultCache<std::vector<RelativeIndex>>> _cache;
+
+
+    std::vector<RelativeIndex> ProcessQuery(const IndexSnapshot& snapshot, const std::string& query, size_t limit,
+                                            QueryScratch& scratch) const;
+
+
+    // Разбирает запрос в scratch: условия в scratch.query, различные слова в scratch.words
+    void ParseQuery(const std::string& query, QueryScratch& scratch) const;
 
 
-    std::vector<std::string> SplitIntoWords(const std::string& text);
+    // Строит scratch.plan и списки слов в порядке плана
+    void PlanQuery(const IndexSnapshot& snapshot, QueryScratch& scratch) const;
 
 
-    std::vector<RelativeIndex> ProcessQuery(const std::string& query);
+    // Строит план запроса и отбирает лучшие документы по нему
+    std::vector<RelativeIndex> RankDocuments(const IndexSnapshot& snapshot, size_t limit, QueryScratch& scratch) const;
 };
\ No newline at end of file
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// Фрагменты документов для предпросмотра результатов поиска
+namespace Snippet {
+    // Фрагмент text длиной около width байт вокруг первого вхождения любого из words
+    // (слов в нижнем регистре, как их возвращает Tokenizer). Текст просматривается
+    // кусками только до первого вхождения; если слов нет, берётся начало текста.
+    // Фрагмент выравнивается по границам слов, пробельные символы сжимаются в один
+    // пробел, обрезанные края отмечаются многоточием.
+    std::string Extract(std::string_view text, const std::vector<std::string_view>& words, size_t width);
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "TermDictionary.h"
+#include "Tokenizer.h"
+
+
+// Построение индекса во внешней памяти (SPIMI). Документы подаются по одному,
+// вхождения копятся в словаре в памяти; когда он превышает бюджет, термины
+// сортируются и словарь сбрасывается во временный файл - прогон. Finish сливает
+// прогоны k-путевым слиянием прямо в файл сегмента, поэтому ни корпус, ни готовый
+// индекс целиком в памяти не находятся. Ошибки ввода-вывода - std::runtime_error.
+class SpimiBuilder {
+public:
+    // temp_directory - каталог для прогонов и сегмента, пустая строка - системный.
+    // with_positions - сохранить в сегменте позиции слов.
+    SpimiBuilder(size_t memory_budget, const std::string& temp_directory, bool with_positions = false);
+
+
+    ~SpimiBuilder();
+
+
+    SpimiBuilder(const SpimiBuilder&) = delete;
+
+
+    SpimiBuilder& operator=(const SpimiBuilder&) = delete;
+
+
+    // Документы нумеруются по порядку поступления
+    void AddDocument(std::string_view content);
+
+
+    // Сливает прогоны в файл сегмента во временном каталоге и возвращает его путь.
+    // Файл удаляет вызывающий.
+    std::string Finish();
+
+
+    size_t GetDocumentCount() const { return document_count; }
+
+
+    size_t GetRunCount() const { return run_paths.size(); }
+
+private:
+    struct RunPosting {
+        uint32_t doc_id;
+        uint32_t count;
+    };
+
+    size_t memory_budget;
+    bool with_positions;
+    std::string temp_prefix; // общее начало имён временных файлов
+    std::string segment_path; // файл сегмента; до успешного Finish удаляется деструктором
+    std::string positions_path; // позиции на время слияния
+    bool finished = false;
+    Tokenizer tokenizer;
+    TermDictionary terms;
+    std::vector<std::vector<RunPosting>> lists; // по идентификатору термина, doc_id по возрастанию
+    std::vector<std::vector<uint32_t>> positions; // позиции вхождений каждого термина подряд
+    size_t posting_bytes = 0; // ёмкость списков вхождений и позиций в байтах
+    uint32_t document_count = 0;
+    std::vector<uint32_t> lengths; // число слов каждого документа, для норм длины
+    std::vector<std::string> run_paths;
+
+
+    size_t MemoryUsage() const;
+
+
+    // Записывает накопленный словарь в новый прогон, термины по возрастанию
+    void FlushRun();
+};
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include "PostingList.h"
+
+
+// Заголовки блоков одного списка: позволяют оценить частоты около документа,
+// не распаковывая блок
+struct BlockBounds {
+    const PostingBlock* blocks = nullptr;
+    size_t count = 0;
+    size_t current = 0;
+
+
+    // Переходит к блоку, который может содержать target; false - таких блоков нет
+    bool AdvanceTo(uint32_t target) {
+        if (current < count && blocks[current].last_doc < target) {
+            current = std::partition_point(blocks + current, blocks + count,
+                                           [target](const PostingBlock& b) { return b.last_doc < target; }) - blocks;
+        }
+        return current < count;
+    }
+};
+
+
+// Курсор слова запроса для вычислителей "документ за документом": обходит список
+// по внутренним номерам (Next, AdvanceTo), оценивает текущее вхождение политикой
+// ранжирования (Score) и даёт верхние границы оценки для всего списка (MaxScore)
+// и для блока около документа (ShallowAdvance + BlockMaxScore), не распаковывая блоки.
+// Курсор не выделяет память, поэтому массивы курсоров переиспользуются между запросами.
+template <typename Ranking>
+class TermCursor {
+public:
+    TermCursor(const PostingsView& view, const Ranking& ranking)
+            : ranking(&ranking), cursor(view.Cursor()) {
+        const PostingList& list = *view.List();
+        bounds = {list.BlockData(), list.BlockCount()};
+        term = ranking.Prepare(list);
+        max_score = ranking.Bound(term, list.MaxCount());
+        size = list.Size();
+    }
+
+
+    bool AtEnd() const { return cursor.AtEnd(); }
+
+
+    uint32_t DocId() const { return cursor.DocId(); }
+
+
+    void Next() { cursor.Next(); }
+
+
+    // Переходит к первому документу с номером >= target
+    void AdvanceTo(uint32_t target) { cursor.AdvanceTo(target); }
+
+
+    float Score() const { return ranking->Score(term, cursor.DocId(), cursor.Count()); }
+
+
+    // Сам курсор списка: блок и частоты текущего вхождения нужны для чтения позиций
+    const PostingCursor& Postings() const { return cursor; }
+
+
+    // Верхняя граница Score по всему списку
+    float MaxScore() const { return max_score; }
+
+
+    // Длина списка, по ней упорядочиваются курсоры
+    size_t Size() const { return size; }
+
+
+    // Переводит границы (но не сам курсор) к блоку, который может содержать target.
+    // false - в списке нет документов с номером >= target.
+    bool ShallowAdvance(uint32_t target) { return bounds.AdvanceTo(target); }
+
+
+    // Верхняя граница Score в блоке, выбранном ShallowAdvance
+    float BlockMaxScore() const { return ranking->Bound(term, bounds.blocks[bounds.current].max_count); }
+
+
+    // Последний документ блока, выбранного ShallowAdvance
+    uint32_t BlockLastDoc() const { return bounds.blocks[bounds.current].last_doc; }
+
+private:
+    const Ranking* ranking;
+    typename Ranking::Term term;
+    PostingCursor cursor;
+    BlockBounds bounds;
+    float max_score = 0.0f;
+    size_t size = 0;
+};
\ No newline at end of file
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+
+// Словарь терминов: хеш-таблица с открытой адресацией (линейное пробирование).
+// Строки хранятся подряд в одной области памяти, каждому термину выдаётся
+// плотный 32-битный идентификатор в порядке добавления.
+class TermDictionary {
+public:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+
+    struct Slot {
+        uint32_t hash; // младшие биты хеша для быстрого отсечения
+        uint32_t id;   // npos - пустая ячейка
+    };
+
+
+    TermDictionary() = default;
+
+
+    // Идентификатор термина или npos, если его нет
+    uint32_t Find(std::string_view term) const;
+
+
+    // Идентификатор термина; новый термин получает следующий свободный идентификатор
+    uint32_t Insert(std::string_view term) { return Insert(term, Hash(term)); }
+
+
+    // То же с заранее вычисленным Hash(term)
+    uint32_t Insert(std::string_view term, uint64_t hash);
+
+
+    std::string_view Term(uint32_t id) const {
+        const uint64_t* bounds = OffsetData();
+        // Подключённые таблицы не проверялись при открытии, поэтому границы термина сверяются здесь
+        if (mapped_slots && (id >= mapped_term_count || bounds[id] > bounds[id + 1]
+                             || bounds[id + 1] > bounds[mapped_term_count])) {
+            throw std::runtime_error("term dictionary is malformed");
+        }
+        return {ArenaData() + bounds[id], static_cast<size_t>(bounds[id + 1] - bounds[id])};
+    }
+
+
+    size_t Size() const { return mapped_slots ? mapped_term_count : offsets.size() - 1; }
+
+
+    size_t ArenaSize() const { return OffsetData()[Size()]; }
+
+
+    // Таблицы словаря, например для записи в файл
+    const Slot* SlotData() const { return mapped_slots ? mapped_slots : slots.data(); }
+
+
+    size_t SlotCount() const { return mapped_slots ? mapped_slot_count : slots.size(); }
+
+
+    const uint64_t* OffsetData() const { return mapped_slots ? mapped_offsets : offsets.data(); }
+
+
+    const char* ArenaData() const { return mapped_slots ? mapped_arena : arena.data(); }
+
+
+    // Подключает готовые таблицы (например, отображённые в память) без копирования.
+    // Память должна жить дольше словаря; при первом изменении таблицы копируются.
+    // slot_count - степень двойки, offsets содержит term_count + 1 элементов, последний -
+    // размер arena. Содержимое таблиц проверяется при обращении к ним (std::runtime_error).
+    void Attach(const Slot* slot_data, size_t slot_count, const uint64_t* offset_data,
+                size_t term_count, const char* arena_data);
+
+
+    void Reserve(size_t term_count, size_t arena_bytes);
+
+
+    // Удаляет все термины, сохраняя выделенную память
+    void Clear();
+
+
+    // Размер словаря в памяти, включая подключённые таблицы
+    size_t MemoryUsage() const;
+
+
+    static uint64_t Hash(std::string_view term);
+
+private:
+    std::vector<Slot> slots;          // размер - степень двойки
+    std::vector<char> arena;          // строки терминов подряд
+    std::vector<uint64_t> offsets{0}; // начало термина id в arena, последний элемент - конец
+
+    // Подключённые таблицы; пока они заданы, собственные векторы не используются
+    const Slot* mapped_slots = nullptr;
+    size_t mapped_slot_count = 0;
+    const uint64_t* mapped_offsets = nullptr;
+    size_t mapped_term_count = 0;
+    const char* mapped_arena = nullptr;
+
+
+    size_t Probe(std::string_view term, uint64_t hash) const;
+
+
+    void Rehash(size_t slot_count);
+
+
+    // Копирует подключённые таблицы в собственную память перед изменением
+    void Detach();
+};
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+// Пул потоков с локальными очередями задач и "воровством" работы у соседей.
+// Используется индексацией, загрузкой документов и обработкой запросов.
+class ThreadPool {
+public:
+    // thread_count == 0 - по числу аппаратных потоков
+    explicit ThreadPool(size_t thread_count = 0);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+
+    size_t Size() const { return workers.size(); }
+
+
+    template <typename F>
+    auto Submit(F&& task) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+        using Result = std::invoke_result_t<std::decay_t<F>>;
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        auto future = packaged->get_future();
+        Push([packaged]() { (*packaged)(); });
+        return future;
+    }
+
+
+    // Делит диапазон [0, count) на куски по chunk_size и обрабатывает их параллельно.
+    // Вызывающий поток участвует в работе, поэтому вызов безопасен и изнутри задач пула.
+    void ParallelFor(size_t count, size_t chunk_size, const std::function<void(size_t, size_t)>& body);
+
+
+    // Размер куска, при котором на каждый поток приходится несколько кусков
+    size_t ChunkSize(size_t count) const;
+
+
+    // Общий пул по умолчанию для компонентов, которым пул не передали явно
+    static ThreadPool& Shared();
+
+private:
+    using Task = std::function<void()>;
+
+    struct WorkQueue {
+        std::deque<Task> tasks;
+        std::mutex mutex;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues; // очередь задач для каждого потока
+    std::vector<std::thread> workers;
+    std::atomic<size_t> next_queue{0};
+    std::atomic<size_t> pending{0}; // число задач, ещё не взятых в работу
+    std::atomic<bool> stopping{false};
+    std::mutex sleep_mutex;
+    std::condition_variable wake_up;
+
+
+    void Push(Task task);
+
+
+    bool TryPop(size_t index, Task& task);
+
+
+    bool TrySteal(size_t thief, Task& task);
+
+
+    // Выполняет одну ожидающую задачу, если она есть
+    bool RunPendingTask();
+
+
+    void WorkerLoop(size_t index);
+};
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// Разбивает текст на слова по пробельным символам и переводит ASCII-буквы
+// в нижний регистр. Байты классифицируются блоками по 32 (AVX2) или 16 (SSE2)
+// за раз, реализация выбирается при запуске. Слова возвращаются как string_view
+// во внутренний буфер, который переиспользуется между вызовами, поэтому
+// на отдельные слова память не выделяется.
+class Tokenizer {
+public:
+    Tokenizer() = default;
+
+
+    // Результат действителен до следующего вызова Tokenize
+    const std::vector<std::string_view>& Tokenize(std::string_view text);
+
+
+    // Смещение слова из результата Tokenize от начала текста
+    size_t Offset(std::string_view token) const { return static_cast<size_t>(token.data() - lowered.data()); }
+
+
+    // Имя реализации, выбранной при запуске: "avx2", "sse2" или "scalar"
+    static const char* ImplementationName();
+
+private:
+    std::string lowered; // текст в нижнем регистре, на него ссылаются слова
+    std::vector<std::string_view> tokens;
+};
\ No newline at end of file
@@ -3,6 +3,29 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <functional>
+#include <string_view>
+#include <memory>
+#include "AnswersWriter.h"
+#include "DocumentLoader.h"
+#include "IndexSegment.h"
+
+
+// Изменение файла документа с момента последней загрузки
+struct DocumentChange {
+    enum class Kind { Added, Modified, Removed };
+
+    Kind kind;
+    size_t doc_id;
+    std::string content; // пусто для Removed
+};
+
+
+// Запрос из файла JSON Lines
+struct RequestLine {
+    std::string id;   // поле id строки как JSON (число или строка в кавычках), пусто - ответ получает номер requestNNN
+    std::string text; // текст запроса, пусто для строки с ошибкой
+};
 
 
 class ConverterJSON {
@@ -10,16 +33,131 @@ public:
     ConverterJSON();
 
 
+    // Тексты всех документов по номерам; файлы загружаются параллельно на общем пуле
     std::vector<std::string> GetTextDocuments();
 
 
+    // Загружает файлы документов через loader (параллельно, без копирования отображённых
+    // файлов) и возвращает тексты по номерам документов. Тексты действительны, пока жив loader.
+    std::vector<std::string_view> LoadTextDocuments(DocumentLoader& loader);
+
+
+    // Читает документы по одному и передаёт их consume в порядке номеров,
+    // не накапливая тексты в памяти; состояние файлов обновляется как в GetTextDocuments
+    void StreamTextDocuments(const std::function<void(const std::string&)>& consume);
+
+
+    // Фрагмент документа doc_id длиной около width байт вокруг первого из words (см. Snippet.h).
+    // Файл документа отображается в память только на время поиска фрагмента, поэтому
+    // время не зависит от размера корпуса. false - документа нет или файл недоступен.
+    bool GetDocumentSnippet(size_t doc_id, const std::vector<std::string_view>& words, size_t width,
+                            std::string& snippet) const;
+
+
+    // Файлы, изменившиеся с последнего вызова GetTextDocuments или GetChangedDocuments.
+    // Изменения определяются по размеру и времени модификации, читаются только изменённые файлы.
+    std::vector<DocumentChange> GetChangedDocuments();
+
+
+    // Содержимое загруженных файлов по номерам документов; состояние файлов не меняется
+    std::vector<std::string> GetIndexedDocuments() const;
+
+
+    // Состояние файлов на момент последней загрузки, сохраняется вместе с индексом
+    const std::vector<SourceFile>& GetSourceFiles() const { return file_stamps; }
+
+
+    // Восстанавливает состояние файлов из сохранённого индекса.
+    // Возвращает false, если список файлов в config.json с тех пор изменился.
+    bool RestoreSourceFiles(std::vector<SourceFile> sources);
+
+
     int GetResponsesLimit();
 
 
+    // Число потоков пула, 0 - по числу аппаратных потоков
+    size_t GetThreadCount() const;
+
+
+    // Число обработчиков пакета запросов, 0 - по числу потоков пула, 1 - последовательно
+    size_t GetSearchThreads() const;
+
+
+    // Память (в байтах) кэша результатов запросов, 0 - кэш отключён
+    size_t GetCacheMemory() const;
+
+
+    // Способ построения индекса: "sharded", "locked" или "spimi"
+    std::string GetBuildMode() const;
+
+
+    // Способ отбора лучших документов: "block_max", "daat" или "exhaustive"
+    std::string GetEvaluation() const;
+
+
+    // Способ пересечения списков в режиме exhaustive: "auto", "merge", "gallop" или "bitmap"
+    std::string GetIntersection() const;
+
+
+    // Формула релевантности: "sum" или "bm25"
+    std::string GetRanking() const;
+
+
+    // Сколько слов запроса должен содержать документ: "all", "any" или "at_least"
+    std::string GetMatchMode() const;
+
+
+    // Наименьшее число слов запроса в документе для режима "at_least"
+    size_t GetMinimumMatch() const;
+
+
+    // Хранить ли позиции слов для фраз и NEAR
+    bool GetPositions() const;
+
+
+    // Файл сегмента индекса, пустая строка - индекс не сохраняется
+    std::string GetIndexPath() const;
+
+
+    // Память (в байтах) для накопления частичного индекса в режиме spimi
+    size_t GetMemoryBudget() const;
+
+
+    // Каталог для временных файлов построения, пустая строка - системный
+    std::string GetTempDirectory() const;
+
+
     std::vector<std::string> GetRequests();
 
 
-    void putAnswers(std::vector<std::vector<std::pair<int, float>>> answers);
+    // Читает requests.json потоково (SAX), не строя дерево документа: каждый запрос передаётся
+    // consume сразу после разбора, поэтому память не зависит от размера файла. consume
+    // возвращает false, чтобы прекратить чтение. Возвращает число переданных запросов.
+    size_t StreamRequests(const std::function<bool(std::string&&)>& consume);
+
+
+    // Читает запросы JSON Lines из path по строке: строка - JSON-строка с запросом или объект
+    // {"request": "...", "id": ...} (id - строка или число). Пустые строки пропускаются,
+    // на строку с ошибкой передаётся пустой запрос, чтобы ответы шли строка в строку.
+    // consume возвращает false, чтобы прекратить чтение. Возвращает число переданных запросов.
+    size_t StreamRequestLines(const std::string& path, const std::function<bool(RequestLine&&)>& consume) const;
+
+
+    // Формат файла ответов: "json", "compact", "cbor" или "msgpack"
+    std::string GetAnswersFormat() const;
+
+
+    // Открывает файл ответов в формате answers_format для потоковой записи; расширение
+    // файла соответствует формату (answers.json, answers.cbor, answers.msgpack)
+    std::unique_ptr<AnswersWriter> OpenAnswers() const;
+
+
+    // Открывает файл ответов JSON Lines path, пустой path - answers.jsonl рядом с answers.json
+    std::unique_ptr<AnswersWriter> OpenAnswerLines(const std::string& path) const;
+
+
+    // Записывает не более max_responses ответов на каждый запрос
+    void putAnswers(const std::vector<std::vector<std::pair<int, float>>>& answers);
 
 
     bool ConfigFileExists() const;
@@ -37,8 +175,29 @@ private:
     std::string name;
     std::string version;
     int max_responses;
+    size_t thread_count = 0;
+    size_t search_threads = 0;
+    size_t cache_memory_mb = 64;
+    std::string build_mode = "sharded";
+    std::string evaluation = "block_max";
+    std::string intersection = "auto";
+    std::string ranking = "sum";
+    std::string match_mode = "all";
+    size_t min_match = 2;
+    bool positions = false;
+    std::string index_path;
+    size_t memory_budget_mb = 1024;
+    std::string temp_dir;
+    std::string answers_format = "json";
     std::vector<std::string> file_paths;
+    std::vector<SourceFile> file_stamps; // состояние файлов из file_paths на момент последней загрузки
+    std::vector<size_t> document_files; // номер документа -> индекс в file_stamps
+    size_t next_doc_id = 0;
 
 
     void ReadConfig();
+
+
+    // Читает файл целиком и запоминает его размер и время модификации
+    bool ReadDocument(size_t file_index, std::string& content);
 };
\ No newline at end of file
@@ -0,0 +1,424 @@
+#include "../include/AnswersWriter.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+    // Число в том же виде, в каком его выводит nlohmann::json (1.0, 0.4000000059604645)
+    void AppendNumber(std::string& text, float value) {
+        if (!std::isfinite(value)) {
+            text += "null";
+            return;
+        }
+
+        char buffer[64];
+        char* end = nlohmann::detail::to_chars(buffer, buffer + sizeof(buffer), static_cast<double>(value));
+        text.append(buffer, end);
+    }
+
+    // Перевод строки с отступом depth уровней по 4 пробела; в компактном формате ничего
+    void AppendLine(std::string& text, bool pretty, size_t depth) {
+        if (pretty) {
+            text += '\n';
+            text.append(depth * 4, ' ');
+        }
+    }
+
+    // Строка JSON с экранированием, как у nlohmann::json
+    void AppendString(std::string& text, std::string_view value) {
+        static const char hex[] = "0123456789abcdef";
+        text += '"';
+        for (char c : value) {
+            switch (c) {
+                case '"':
+                    text += "\\\"";
+                    break;
+                case '\\':
+                    text += "\\\\";
+                    break;
+                case '\b':
+                    text += "\\b";
+                    break;
+                case '\f':
+                    text += "\\f";
+                    break;
+                case '\n':
+                    text += "\\n";
+                    break;
+                case '\r':
+                    text += "\\r";
+                    break;
+                case '\t':
+                    text += "\\t";
+                    break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        text += "\\u00";
+                        text += hex[(c >> 4) & 15];
+                        text += hex[c & 15];
+                    } else {
+                        text += c;
+                    }
+            }
+        }
+        text += '"';
+    }
+
+    // "key": или "key": с пробелом в формате с отступами
+    void AppendKey(std::string& text, bool pretty, std::string_view key) {
+        AppendString(text, key);
+        text += pretty ? ": " : ":";
+    }
+
+    // Поля docid и rank документа ответа
+    void AppendDocument(std::string& text, bool pretty, size_t depth, const std::pair<int, float>& entry) {
+        AppendLine(text, pretty, depth);
+        AppendKey(text, pretty, "docid");
+        text += std::to_string(entry.first);
+        text += ',';
+        AppendLine(text, pretty, depth);
+        AppendKey(text, pretty, "rank");
+        AppendNumber(text, entry.second);
+    }
+
+    // Число из length байт старшим байтом вперёд, как в CBOR и MessagePack
+    void AppendBigEndian(std::vector<uint8_t>& bytes, uint32_t value, int length) {
+        for (int shift = 8 * (length - 1); shift >= 0; shift -= 8) {
+            bytes.push_back(static_cast<uint8_t>(value >> shift));
+        }
+    }
+
+    // Двоичные форматы кодируются так же, как их кодирует nlohmann::json (to_cbor, to_msgpack):
+    // целые - в наименьшей форме, float - 4 байтами; from_cbor и from_msgpack читают их без потерь.
+    // Ответ кодируется прямо в буфер, без промежуточного значения json на каждый ответ.
+
+    // Заголовок CBOR: старший тип major и число value (длина, число элементов или само целое)
+    void AppendCborHead(std::vector<uint8_t>& bytes, uint8_t major, uint32_t value) {
+        uint8_t type = static_cast<uint8_t>(major << 5);
+        if (value < 24) {
+            bytes.push_back(static_cast<uint8_t>(type | value));
+        } else if (value <= 0xFF) {
+            bytes.push_back(type | 24);
+            AppendBigEndian(bytes, value, 1);
+        } else if (value <= 0xFFFF) {
+            bytes.push_back(type | 25);
+            AppendBigEndian(bytes, value, 2);
+        } else {
+            bytes.push_back(type | 26);
+            AppendBigEndian(bytes, value, 4);
+        }
+    }
+
+    void AppendCborString(std::vector<uint8_t>& bytes, const std::string& value) {
+        AppendCborHead(bytes, 3, static_cast<uint32_t>(value.size()));
+        bytes.insert(bytes.end(), value.begin(), value.end());
+    }
+
+    void AppendCborInteger(std::vector<uint8_t>& bytes, int value) {
+        if (value >= 0) {
+            AppendCborHead(bytes, 0, static_cast<uint32_t>(value));
+        } else {
+            AppendCborHead(bytes, 1, static_cast<uint32_t>(-1 - static_cast<int64_t>(value)));
+        }
+    }
+
+    void AppendCborFloat(std::vector<uint8_t>& bytes, float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        bytes.push_back(0xFA);
+        AppendBigEndian(bytes, bits, 4);
+    }
+
+    // Заголовок объекта или массива MessagePack: fix - код для размеров меньше 16,
+    // code16 - код с 2-байтовым размером, за ним идёт код с 4-байтовым
+    void AppendMsgpackHead(std::vector<uint8_t>& bytes, uint8_t fix, uint8_t code16, uint32_t size) {
+        if (size < 16) {
+            bytes.push_back(static_cast<uint8_t>(fix | size));
+        } else if (size <= 0xFFFF) {
+            bytes.push_back(code16);
+            AppendBigEndian(bytes, size, 2);
+        } else {
+            bytes.push_back(code16 + 1);
+            AppendBigEndian(bytes, size, 4);
+        }
+    }
+
+    void AppendMsgpackString(std::vector<uint8_t>& bytes, const std::string& value) {
+        uint32_t size = static_cast<uint32_t>(value.size());
+        if (size < 32) {
+            bytes.push_back(static_cast<uint8_t>(0xA0 | size));
+        } else if (size <= 0xFF) {
+            bytes.push_back(0xD9);
+            AppendBigEndian(bytes, size, 1);
+        } else if (size <= 0xFFFF) {
+            bytes.push_back(0xDA);
+            AppendBigEndian(bytes, size, 2);
+        } else {
+            bytes.push_back(0xDB);
+            AppendBigEndian(bytes, size, 4);
+        }
+        bytes.insert(bytes.end(), value.begin(), value.end());
+    }
+
+    void AppendMsgpackInteger(std::vector<uint8_t>& bytes, int value) {
+        if (value >= 0) {
+            uint32_t number = static_cast<uint32_t>(value);
+            if (number < 128) {
+                bytes.push_back(static_cast<uint8_t>(number));
+            } else if (number <= 0xFF) {
+                bytes.push_back(0xCC);
+                AppendBigEndian(bytes, number, 1);
+            } else if (number <= 0xFFFF) {
+                bytes.push_back(0xCD);
+                AppendBigEndian(bytes, number, 2);
+            } else {
+                bytes.push_back(0xCE);
+                AppendBigEndian(bytes, number, 4);
+            }
+        } else if (value >= -32) {
+            bytes.push_back(static_cast<uint8_t>(value));
+        } else if (value >= INT8_MIN) {
+            bytes.push_back(0xD0);
+            AppendBigEndian(bytes, static_cast<uint32_t>(value), 1);
+        } else if (value >= INT16_MIN) {
+            bytes.push_back(0xD1);
+            AppendBigEndian(bytes, static_cast<uint32_t>(value), 2);
+        } else {
+            bytes.push_back(0xD2);
+            AppendBigEndian(bytes, static_cast<uint32_t>(value), 4);
+        }
+    }
+
+    void AppendMsgpackFloat(std::vector<uint8_t>& bytes, float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        bytes.push_back(0xCA);
+        AppendBigEndian(bytes, bits, 4);
+    }
+}
+
+AnswersWriter::Format AnswersWriter::ParseFormat(const std::string& name) {
+    if (name == "compact") {
+        return Format::Compact;
+    }
+    if (name == "cbor") {
+        return Format::Cbor;
+    }
+    if (name == "msgpack") {
+        return Format::MessagePack;
+    }
+    if (name == "jsonl") {
+        return Format::JsonLines;
+    }
+    return Format::Json;
+}
+
+const char* AnswersWriter::Extension(Format format) {
+    switch (format) {
+        case Format::Cbor:
+            return ".cbor";
+        case Format::MessagePack:
+            return ".msgpack";
+        case Format::JsonLines:
+            return ".jsonl";
+        default:
+            return ".json";
+    }
+}
+
+AnswersWriter::AnswersWriter(const std::string& path, Format format, size_t max_responses)
+        : path(path), file(path, std::ios::binary | std::ios::trunc), format(format), max_responses(max_responses) {
+    if (!file.is_open()) {
+        throw std::runtime_error("cannot open answers file: " + path);
+    }
+
+    if (format == Format::JsonLines) {
+        return;
+    }
+    if (format == Format::Json || format == Format::Compact) {
+        text = format == Format::Json ? "{\n    \"answers\": {" : "{\"answers\":{";
+        file.write(text.data(), static_cast<std::streamsize>(text.size()));
+        return;
+    }
+
+    // Корневой объект из одного ключа "answers"; число ответов заранее неизвестно, поэтому
+    // вложенный объект получает заголовок с 4-байтовым числом элементов, которое Finish
+    // записывает на место нулей
+    if (format == Format::Cbor) {
+        AppendCborHead(bytes, 5, 1);
+        AppendCborString(bytes, "answers");
+        count_offset = static_cast<std::streamoff>(bytes.size());
+        bytes.push_back(0xBA);
+    } else {
+        AppendMsgpackHead(bytes, 0x80, 0xDE, 1);
+        AppendMsgpackString(bytes, "answers");
+        count_offset = static_cast<std::streamoff>(bytes.size());
+        bytes.push_back(0xDF);
+    }
+    AppendBigEndian(bytes, 0, 4);
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+AnswersWriter::~AnswersWriter() {
+    if (!finished) {
+        try {
+            Finish();
+        } catch (const std::exception&) {
+        }
+    }
+}
+
+void AnswersWriter::Write(const std::vector<std::pair<int, float>>& answer, std::string_view id) {
+    size_t size = max_responses > 0 ? std::min(answer.size(), max_responses) : answer.size();
+
+    // request001, request002, ...: номер дополняется нулями до трёх цифр
+    std::string number = std::to_string(count + 1);
+    std::string request_id = "request" + std::string(number.size() < 3 ? 3 - number.size() : 0, '0') + number;
+
+    if (format != Format::Cbor && format != Format::MessagePack) {
+        WriteText(request_id, id, answer, size);
+        file.write(text.data(), static_cast<std::streamsize>(text.size()));
+    } else {
+        WriteBinary(request_id, answer, size);
+        file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    if (!file) {
+        throw std::runtime_error("cannot write answers file: " + path);
+    }
+    ++count;
+}
+
+void AnswersWriter::WriteText(const std::string& request_id, std::string_view id,
+                              const std::vector<std::pair<int, float>>& answer, size_t size) {
+    // Ключи объектов идут по алфавиту, как их выводит nlohmann::json
+    bool pretty = format == Format::Json;
+    bool lines = format == Format::JsonLines;
+
+    text.clear();
+    if (lines) {
+        // Строка JSON Lines - отдельный объект, идентификатор запроса в поле id с тем же
+        // типом JSON, что в запросе
+        text += '{';
+        AppendKey(text, false, "id");
+        if (id.empty()) {
+            AppendString(text, request_id);
+        } else {
+            text += id;
+        }
+        text += ',';
+    } else {
+        if (count > 0) {
+            text += ',';
+        }
+        AppendLine(text, pretty, 2);
+        AppendKey(text, pretty, request_id);
+        text += '{';
+    }
+
+    if (size > 1) {
+        AppendLine(text, pretty, 3);
+        AppendKey(text, pretty, "relevance");
+        text += '[';
+        for (size_t i = 0; i < size; ++i) {
+            if (i > 0) {
+                text += ',';
+            }
+            AppendLine(text, pretty, 4);
+            text += '{';
+            AppendDocument(text, pretty, 5, answer[i]);
+            AppendLine(text, pretty, 4);
+            text += '}';
+        }
+        AppendLine(text, pretty, 3);
+        text += "],";
+    } else if (size == 1) {
+        AppendDocument(text, pretty, 3, answer[0]);
+        text += ',';
+    }
+
+    AppendLine(text, pretty, 3);
+    AppendKey(text, pretty, "result");
+    text += size > 0 ? "true" : "false";
+    AppendLine(text, pretty, 2);
+    text += lines ? "}\n" : "}";
+}
+
+void AnswersWriter::WriteBinary(const std::string& request_id, const std::vector<std::pair<int, float>>& answer,
+                                size_t size) {
+    // Ключи объектов идут по алфавиту, как у текстовых форматов
+    bool cbor = format == Format::Cbor;
+    auto head = [this, cbor](bool map, uint32_t length) {
+        if (cbor) {
+            AppendCborHead(bytes, map ? 5 : 4, length);
+        } else {
+            AppendMsgpackHead(bytes, map ? 0x80 : 0x90, map ? 0xDE : 0xDC, length);
+        }
+    };
+    auto string = [this, cbor](const std::string& value) {
+        cbor ? AppendCborString(bytes, value) : AppendMsgpackString(bytes, value);
+    };
+    auto document = [this, cbor, &string](const std::pair<int, float>& entry) {
+        string("docid");
+        cbor ? AppendCborInteger(bytes, entry.first) : AppendMsgpackInteger(bytes, entry.first);
+        string("rank");
+        cbor ? AppendCborFloat(bytes, entry.second) : AppendMsgpackFloat(bytes, entry.second);
+    };
+
+    bytes.clear();
+    string(request_id);
+    if (size > 1) {
+        head(true, 2);
+        string("relevance");
+        head(false, static_cast<uint32_t>(size));
+        for (size_t i = 0; i < size; ++i) {
+            head(true, 2);
+            document(answer[i]);
+        }
+    } else if (size == 1) {
+        head(true, 3);
+        document(answer[0]);
+    } else {
+        head(true, 1);
+    }
+
+    string("result");
+    if (cbor) {
+        bytes.push_back(size > 0 ? 0xF5 : 0xF4);
+    } else {
+        bytes.push_back(size > 0 ? 0xC3 : 0xC2);
+    }
+}
+
+void AnswersWriter::Flush() {
+    file.flush();
+    if (!file) {
+        throw std::runtime_error("cannot write answers file: " + path);
+    }
+}
+
+void AnswersWriter::Finish() {
+    if (finished) {
+        return;
+    }
+    finished = true;
+
+    if (format == Format::Json) {
+        file << (count > 0 ? "\n    }\n}\n" : "}\n}\n");
+    } else if (format == Format::Compact) {
+        file << "}}\n";
+    } else if (format != Format::JsonLines) {
+        bytes.clear();
+        AppendBigEndian(bytes, static_cast<uint32_t>(count), 4);
+        file.seekp(count_offset + 1);
+        file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    file.close();
+    if (file.fail()) {
+        throw std::runtime_error("cannot write answers file: " + path);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,251 @@
+#include "../include/BitPacking.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BITPACKING_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+    // Число групп по 8 значений (по одному из каждой полосы), покрывающих count значений
+    size_t Groups(size_t count) {
+        return (count + BitPacking::lanes - 1) / BitPacking::lanes;
+    }
+
+    uint32_t Mask(uint32_t bits) {
+        return bits == 32 ? 0xFFFFFFFFu : (1u << bits) - 1;
+    }
+
+    void UnpackScalar(const uint32_t* in, size_t count, uint32_t bits, uint32_t add, uint32_t* out) {
+        if (bits == 0) {
+            std::fill(out, out + Groups(count) * BitPacking::lanes, add);
+            return;
+        }
+
+        uint32_t mask = Mask(bits);
+        for (size_t k = 0; k < Groups(count); ++k) {
+            size_t position = k * bits;
+            size_t word = position / 32;
+            uint32_t shift = position % 32;
+
+            for (size_t lane = 0; lane < BitPacking::lanes; ++lane) {
+                uint32_t value = in[word * BitPacking::lanes + lane] >> shift;
+                if (shift + bits > 32) {
+                    value |= in[(word + 1) * BitPacking::lanes + lane] << (32 - shift);
+                }
+                out[k * BitPacking::lanes + lane] = (value & mask) + add;
+            }
+        }
+    }
+
+    void UnpackDeltaScalar(const uint32_t* in, size_t count, uint32_t bits, uint32_t base, uint32_t* out) {
+        UnpackScalar(in, count, bits, 0, out);
+        for (size_t i = 0; i < Groups(count) * BitPacking::lanes; ++i) {
+            base += out[i];
+            out[i] = base;
+        }
+    }
+
+#ifdef BITPACKING_X86
+    // Восемь значений группы k (по одному из каждой полосы) - это подряд идущие числа 8k..8k+7
+    __attribute__((target("sse2")))
+    void LoadGroupSse(const uint32_t* in, size_t k, uint32_t bits, __m128i mask, __m128i& low, __m128i& high) {
+        size_t position = k * bits;
+        size_t word = position / 32;
+        uint32_t shift = position % 32;
+
+        __m128i shift_right = _mm_cvtsi32_si128(static_cast<int>(shift));
+        auto row = reinterpret_cast<const __m128i*>(in + word * BitPacking::lanes);
+        low = _mm_srl_epi32(_mm_loadu_si128(row), shift_right);
+        high = _mm_srl_epi32(_mm_loadu_si128(row + 1), shift_right);
+
+        if (shift + bits > 32) {
+            __m128i shift_left = _mm_cvtsi32_si128(static_cast<int>(32 - shift));
+            low = _mm_or_si128(low, _mm_sll_epi32(_mm_loadu_si128(row + 2), shift_left));
+            high = _mm_or_si128(high, _mm_sll_epi32(_mm_loadu_si128(row + 3), shift_left));
+        }
+
+        low = _mm_and_si128(low, mask);
+        high = _mm_and_si128(high, mask);
+    }
+
+    __attribute__((target("sse2")))
+    void UnpackSse(const uint32_t* in, size_t count, uint32_t bits, uint32_t add, uint32_t* out) {
+        if (bits == 0) {
+            std::fill(out, out + Groups(count) * BitPacking::lanes, add);
+            return;
+        }
+
+        __m128i mask = _mm_set1_epi32(static_cast<int>(Mask(bits)));
+        __m128i offset = _mm_set1_epi32(static_cast<int>(add));
+        auto target = reinterpret_cast<__m128i*>(out);
+
+        for (size_t k = 0; k < Groups(count); ++k) {
+            __m128i low, high;
+            LoadGroupSse(in, k, bits, mask, low, high);
+            _mm_storeu_si128(target + 2 * k, _mm_add_epi32(low, offset));
+            _mm_storeu_si128(target + 2 * k + 1, _mm_add_epi32(high, offset));
+        }
+    }
+
+    __attribute__((target("sse2")))
+    __m128i PrefixSumSse(__m128i values) {
+        values = _mm_add_epi32(values, _mm_slli_si128(values, 4));
+        return _mm_add_epi32(values, _mm_slli_si128(values, 8));
+    }
+
+    __attribute__((target("sse2")))
+    void UnpackDeltaSse(const uint32_t* in, size_t count, uint32_t bits, uint32_t base, uint32_t* out) {
+        __m128i mask = _mm_set1_epi32(static_cast<int>(Mask(bits)));
+        __m128i carry = _mm_set1_epi32(static_cast<int>(base));
+        auto target = reinterpret_cast<__m128i*>(out);
+
+        for (size_t k = 0; k < Groups(count); ++k) {
+            __m128i low, high;
+            if (bits == 0) {
+                low = high = _mm_setzero_si128();
+            } else {
+                LoadGroupSse(in, k, bits, mask, low, high);
+            }
+
+            low = _mm_add_epi32(PrefixSumSse(low), carry);
+            carry = _mm_shuffle_epi32(low, _MM_SHUFFLE(3, 3, 3, 3));
+            high = _mm_add_epi32(PrefixSumSse(high), carry);
+            carry = _mm_shuffle_epi32(high, _MM_SHUFFLE(3, 3, 3, 3));
+
+            _mm_storeu_si128(target + 2 * k, low);
+            _mm_storeu_si128(target + 2 * k + 1, high);
+        }
+    }
+
+    __attribute__((target("avx2")))
+    __m256i LoadGroupAvx2(const uint32_t* in, size_t k, uint32_t bits, __m256i mask) {
+        size_t position = k * bits;
+        size_t word = position / 32;
+        uint32_t shift = position % 32;
+
+        auto row = reinterpret_cast<const __m256i*>(in + word * BitPacking::lanes);
+        __m256i values = _mm256_srl_epi32(_mm256_loadu_si256(row), _mm_cvtsi32_si128(static_cast<int>(shift)));
+
+        if (shift + bits > 32) {
+            __m256i next = _mm256_loadu_si256(row + 1);
+            values = _mm256_or_si256(values, _mm256_sll_epi32(next, _mm_cvtsi32_si128(static_cast<int>(32 - shift))));
+        }
+
+        return _mm256_and_si256(values, mask);
+    }
+
+    __attribute__((target("avx2")))
+    void UnpackAvx2(const uint32_t* in, size_t count, uint32_t bits, uint32_t add, uint32_t* out) {
+        if (bits == 0) {
+            std::fill(out, out + Groups(count) * BitPacking::lanes, add);
+            return;
+        }
+
+        __m256i mask = _mm256_set1_epi32(static_cast<int>(Mask(bits)));
+        __m256i offset = _mm256_set1_epi32(static_cast<int>(add));
+        auto target = reinterpret_cast<__m256i*>(out);
+
+        for (size_t k = 0; k < Groups(count); ++k) {
+            _mm256_storeu_si256(target + k, _mm256_add_epi32(LoadGroupAvx2(in, k, bits, mask), offset));
+        }
+    }
+
+    __attribute__((target("avx2")))
+    void UnpackDeltaAvx2(const uint32_t* in, size_t count, uint32_t bits, uint32_t base, uint32_t* out) {
+        __m256i mask = _mm256_set1_epi32(static_cast<int>(Mask(bits)));
+        __m256i carry = _mm256_set1_epi32(static_cast<int>(base));
+        __m256i third = _mm256_set1_epi32(3);
+        __m256i last = _mm256_set1_epi32(7);
+        auto target = reinterpret_cast<__m256i*>(out);
+
+        for (size_t k = 0; k < Groups(count); ++k) {
+            __m256i values = bits == 0 ? _mm256_setzero_si256() : LoadGroupAvx2(in, k, bits, mask);
+
+            // префиксная сумма внутри 128-битных половин, затем перенос из младшей половины в старшую
+            values = _mm256_add_epi32(values, _mm256_slli_si256(values, 4));
+            values = _mm256_add_epi32(values, _mm256_slli_si256(values, 8));
+            __m256i low_total = _mm256_permutevar8x32_epi32(values, third);
+            values = _mm256_add_epi32(values, _mm256_blend_epi32(_mm256_setzero_si256(), low_total, 0xF0));
+
+            values = _mm256_add_epi32(values, carry);
+            carry = _mm256_permutevar8x32_epi32(values, last);
+            _mm256_storeu_si256(target + k, values);
+        }
+    }
+#endif
+
+    struct Decoder {
+        const char* name;
+        void (*unpack)(const uint32_t*, size_t, uint32_t, uint32_t, uint32_t*);
+        void (*unpack_delta)(const uint32_t*, size_t, uint32_t, uint32_t, uint32_t*);
+    };
+
+    Decoder SelectDecoder() {
+#ifdef BITPACKING_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return {"avx2", UnpackAvx2, UnpackDeltaAvx2};
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            return {"sse2", UnpackSse, UnpackDeltaSse};
+        }
+#endif
+        return {"scalar", UnpackScalar, UnpackDeltaScalar};
+    }
+
+    const Decoder& ActiveDecoder() {
+        static const Decoder decoder = SelectDecoder();
+        return decoder;
+    }
+}
+
+namespace BitPacking {
+    uint32_t RequiredBits(const uint32_t* values, size_t count) {
+        uint32_t accumulated = 0;
+        for (size_t i = 0; i < count; ++i) {
+            accumulated |= values[i];
+        }
+
+        uint32_t bits = 0;
+        while (bits < 32 && (accumulated >> bits) != 0) {
+            ++bits;
+        }
+        return bits;
+    }
+
+    void Pack(const uint32_t* values, size_t count, uint32_t bits, uint32_t* out) {
+        if (bits == 0) {
+            return;
+        }
+        std::memset(out, 0, PackedWords(bits, count) * sizeof(uint32_t));
+
+        for (size_t k = 0; k < Groups(count); ++k) {
+            size_t position = k * bits;
+            size_t word = position / 32;
+            uint32_t shift = position % 32;
+
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                size_t index = k * lanes + lane;
+                uint32_t value = index < count ? values[index] & Mask(bits) : 0;
+                out[word * lanes + lane] |= value << shift;
+                if (shift + bits > 32) {
+                    out[(word + 1) * lanes + lane] |= value >> (32 - shift);
+                }
+            }
+        }
+    }
+
+    void Unpack(const uint32_t* in, size_t count, uint32_t bits, uint32_t add, uint32_t* out) {
+        ActiveDecoder().unpack(in, count, bits, add, out);
+    }
+
+    void UnpackDelta(const uint32_t* in, size_t count, uint32_t bits, uint32_t base, uint32_t* out) {
+        ActiveDecoder().unpack_delta(in, count, bits, base, out);
+    }
+
+    const char* DecoderName() {
+        return ActiveDecoder().name;
+    }
+}
\ No newline at end of file
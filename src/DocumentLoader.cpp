@@ -0,0 +1,135 @@
+#include "../include/DocumentLoader.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+    // Задача загрузки: один отображаемый файл или пачка мелких файлов
+    struct LoadTask {
+        size_t first, last; // номера файлов в списке batched
+        size_t bytes;       // суммарный размер файлов пачки
+        bool mapped;
+    };
+
+    // Читает до size байт файла в buffer; возвращает false, если файл не открылся
+    bool ReadFile(const std::string& path, char* buffer, size_t size, size_t& read) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        file.read(buffer, static_cast<std::streamsize>(size));
+        read = static_cast<size_t>(file.gcount());
+        return !file.bad();
+    }
+}
+
+void DocumentLoader::Load(const std::vector<std::string>& paths) {
+    auto startTime = std::chrono::steady_clock::now();
+
+    files.assign(paths.size(), File());
+    mappings.clear();
+    mappings.resize(paths.size());
+    buffers.clear();
+
+    // Размеры и время изменения нужны до чтения, чтобы разложить файлы по задачам
+    std::vector<size_t> sizes(paths.size());
+    std::vector<char> readable(paths.size(), 0);
+    pool.ParallelFor(paths.size(), pool.ChunkSize(paths.size()), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            // file_size не работает для каталогов и других не обычных файлов
+            std::error_code error;
+            auto write_time = fs::last_write_time(paths[i], error);
+            if (error) {
+                if (error != std::errc::no_such_file_or_directory) {
+                    files[i].status = Status::Unreadable;
+                }
+                continue;
+            }
+
+            auto size = fs::file_size(paths[i], error);
+            if (error) {
+                files[i].status = Status::Unreadable;
+                continue;
+            }
+
+            files[i].write_time = write_time.time_since_epoch().count();
+            sizes[i] = static_cast<size_t>(size);
+            readable[i] = 1;
+        }
+    });
+
+    // Файлы обходятся по порядку: мелкие собираются в пачки, крупные идут отдельными задачами
+    std::vector<size_t> batched;
+    std::vector<LoadTask> tasks;
+    LoadTask batch{0, 0, 0, false};
+    auto closeBatch = [&]() {
+        if (batch.last > batch.first) {
+            tasks.push_back(batch);
+        }
+        batch = {batched.size(), batched.size(), 0, false};
+    };
+
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (!readable[i]) {
+            continue;
+        }
+
+        if (sizes[i] >= mapping_threshold) {
+            closeBatch();
+            batched.push_back(i);
+            tasks.push_back({batched.size() - 1, batched.size(), sizes[i], true});
+            batch = {batched.size(), batched.size(), 0, false};
+            continue;
+        }
+
+        batched.push_back(i);
+        batch.last = batched.size();
+        batch.bytes += sizes[i];
+        if (batch.last - batch.first >= batch_files || batch.bytes >= batch_bytes) {
+            closeBatch();
+        }
+    }
+    closeBatch();
+
+    buffers.resize(tasks.size());
+    pool.ParallelFor(tasks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            const LoadTask& task = tasks[t];
+            if (task.mapped) {
+                size_t i = batched[task.first];
+                try {
+                    mappings[i] = std::make_unique<MappedFile>(paths[i]);
+                    files[i].content = std::string_view(mappings[i]->Data(), mappings[i]->Size());
+                    files[i].status = Status::Loaded;
+                } catch (const std::runtime_error&) {
+                    files[i].status = Status::Unreadable;
+                }
+                continue;
+            }
+
+            buffers[t] = std::make_unique<char[]>(task.bytes);
+            char* target = buffers[t].get();
+            for (size_t k = task.first; k < task.last; ++k) {
+                size_t i = batched[k];
+                size_t read = 0;
+                if (ReadFile(paths[i], target, sizes[i], read)) {
+                    files[i].content = std::string_view(target, read);
+                    files[i].status = Status::Loaded;
+                } else {
+                    files[i].status = Status::Unreadable;
+                }
+                target += sizes[i];
+            }
+        }
+    });
+
+    loaded_bytes = 0;
+    for (const File& file : files) {
+        loaded_bytes += file.content.size();
+    }
+    load_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
\ No newline at end of file
@@ -0,0 +1,202 @@
+#include "../include/IndexSegment.h"
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+    const char zeros[8] = {};
+
+    template <typename T>
+    void Put(std::string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    T Take(const char*& data, const char* end) {
+        if (static_cast<size_t>(end - data) < sizeof(T)) {
+            throw std::runtime_error("index segment source table is truncated");
+        }
+
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        data += sizeof(T);
+        return value;
+    }
+}
+
+namespace IndexSegment {
+    uint64_t Checksum(const char* data, size_t size) {
+        // Четыре независимые цепочки по 8 байт, чтобы умножения шли параллельно
+        const uint64_t prime = 0x9E3779B97F4A7C15ull;
+        uint64_t lanes[4] = {1, 2, 3, 4};
+
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            for (size_t lane = 0; lane < 4; ++lane) {
+                uint64_t word;
+                std::memcpy(&word, data + i + lane * 8, sizeof(word));
+                lanes[lane] = (lanes[lane] ^ word) * prime;
+                lanes[lane] ^= lanes[lane] >> 29;
+            }
+        }
+
+        uint64_t hash = size;
+        for (uint64_t lane : lanes) {
+            hash = (hash ^ lane) * prime;
+        }
+        for (; i < size; ++i) {
+            hash = (hash ^ static_cast<unsigned char>(data[i])) * prime;
+        }
+
+        return hash ^ (hash >> 32);
+    }
+
+    std::string EncodeSources(const std::vector<SourceFile>& sources) {
+        std::string out;
+        Put<uint64_t>(out, sources.size());
+
+        for (const auto& source : sources) {
+            Put<uint32_t>(out, source.doc_id);
+            Put<uint32_t>(out, source.loaded ? 1 : 0);
+            Put<uint64_t>(out, source.size);
+            Put<int64_t>(out, source.write_time);
+            Put<uint64_t>(out, source.path.size());
+            out += source.path;
+        }
+
+        return out;
+    }
+
+    std::vector<SourceFile> DecodeSources(const char* data, size_t size) {
+        const char* end = data + size;
+        auto count = Take<uint64_t>(data, end);
+
+        std::vector<SourceFile> sources;
+        for (uint64_t i = 0; i < count; ++i) {
+            SourceFile source;
+            source.doc_id = Take<uint32_t>(data, end);
+            source.loaded = Take<uint32_t>(data, end) != 0;
+            source.size = Take<uint64_t>(data, end);
+            source.write_time = Take<int64_t>(data, end);
+
+            auto length = Take<uint64_t>(data, end);
+            if (static_cast<uint64_t>(end - data) < length) {
+                throw std::runtime_error("index segment source table is truncated");
+            }
+            source.path.assign(data, length);
+            data += length;
+
+            sources.push_back(std::move(source));
+        }
+
+        return sources;
+    }
+
+    Writer::Writer(const std::string& path)
+            : path(path), temp_path(path + ".tmp"), out(temp_path, std::ios::binary | std::ios::trunc) {
+        if (!out) {
+            throw std::runtime_error("unable to create " + temp_path);
+        }
+
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.header_size = sizeof(Header);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    }
+
+    void Writer::BeginSection(Section section) {
+        current = section;
+        header.sections[section] = {position, 0, 0};
+    }
+
+    void Writer::Write(const void* data, size_t size) {
+        if (size == 0) {
+            return;
+        }
+
+        out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        header.sections[current].size += size;
+        position += size;
+    }
+
+    void Writer::EndSection() {
+        size_t padding = (8 - position % 8) % 8;
+        out.write(zeros, static_cast<std::streamsize>(padding));
+        position += padding;
+        current = section_count;
+    }
+
+    void Writer::Commit() {
+        out.close();
+        if (!out) {
+            throw std::runtime_error("unable to write " + temp_path);
+        }
+
+        header.file_size = position;
+        {
+            MappedFile written(temp_path);
+            if (written.Size() != position) {
+                throw std::runtime_error("unable to write " + temp_path);
+            }
+            for (auto& section : header.sections) {
+                section.checksum = Checksum(written.Data() + section.offset, section.size);
+            }
+        }
+        header.checksum = 0;
+        header.checksum = Checksum(reinterpret_cast<const char*>(&header), sizeof(Header));
+
+        std::fstream patch(temp_path, std::ios::binary | std::ios::in | std::ios::out);
+        patch.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        patch.close();
+        if (!patch) {
+            throw std::runtime_error("unable to write " + temp_path);
+        }
+
+        fs::rename(temp_path, path);
+    }
+
+    Reader::Reader(const std::string& path) : file(std::make_shared<MappedFile>(path)) {
+        if (file->Size() < sizeof(Header)) {
+            throw std::runtime_error("index segment is truncated");
+        }
+
+        header = reinterpret_cast<const Header*>(file->Data());
+        if (std::memcmp(header->magic, magic, sizeof(magic)) != 0) {
+            throw std::runtime_error("not an index segment");
+        }
+        if (header->version != version) {
+            throw std::runtime_error("unsupported index segment version " + std::to_string(header->version));
+        }
+        if (header->header_size != sizeof(Header) || header->file_size != file->Size()) {
+            throw std::runtime_error("index segment is truncated");
+        }
+
+        Header unsigned_header = *header;
+        unsigned_header.checksum = 0;
+        if (Checksum(reinterpret_cast<const char*>(&unsigned_header), sizeof(Header)) != header->checksum) {
+            throw std::runtime_error("index segment header checksum mismatch");
+        }
+
+        for (const auto& section : header->sections) {
+            if (section.offset < sizeof(Header) || section.offset % 8 != 0
+                || section.offset > header->file_size || section.size > header->file_size - section.offset) {
+                throw std::runtime_error("index segment section is out of bounds");
+            }
+        }
+    }
+
+    void Reader::VerifySection(Section section) const {
+        const SectionEntry& entry = header->sections[section];
+        if (Checksum(file->Data() + entry.offset, entry.size) != entry.checksum) {
+            throw std::runtime_error("index segment section " + std::to_string(section) + " checksum mismatch");
+        }
+    }
+
+    void Reader::Verify() const {
+        for (uint32_t section = 0; section < section_count; ++section) {
+            VerifySection(static_cast<Section>(section));
+        }
+    }
+}
\ No newline at end of file
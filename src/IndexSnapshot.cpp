@@ -0,0 +1,97 @@
+#include "../include/IndexSnapshot.h"
+#include <algorithm>
+#include <cctype>
+#include <string>
+
+PostingsView IndexSnapshot::GetPostings(std::string_view word) const {
+    return GetPostings(FindTerm(word));
+}
+
+const PositionList* IndexSnapshot::GetPositions(std::string_view word) const {
+    return HasPositions() ? GetPositions(FindTerm(word)) : nullptr;
+}
+
+PostingsView IndexSnapshot::GetPostings(uint32_t term_id) const {
+    if (term_id == TermDictionary::npos) {
+        return {};
+    }
+
+    return PostingsView(postings.Postings(term_id), DeletedBitmap(), identity_ids ? nullptr : external_ids.Data());
+}
+
+const PositionList* IndexSnapshot::GetPositions(uint32_t term_id) const {
+    return HasPositions() && term_id != TermDictionary::npos ? &postings.Positions(term_id) : nullptr;
+}
+
+uint32_t IndexSnapshot::FindTerm(std::string_view word) const {
+    bool has_upper = std::any_of(word.begin(), word.end(),
+                                 [](unsigned char c) { return std::isupper(c); });
+
+    if (has_upper) {
+        std::string lower_word(word);
+        std::transform(lower_word.begin(), lower_word.end(), lower_word.begin(),
+                       [](unsigned char c) { return std::tolower(c); });
+        return FindLowerTerm(lower_word);
+    }
+
+    return FindLowerTerm(word);
+}
+
+uint32_t IndexSnapshot::FindLowerTerm(std::string_view term) const {
+    uint32_t id = dictionary->Find(term);
+    if (id != TermDictionary::npos || added_terms.Size() == 0) {
+        return id;
+    }
+
+    uint32_t added_id = added_terms.Find(term);
+    return added_id == TermDictionary::npos ? added_id : static_cast<uint32_t>(dictionary->Size() + added_id);
+}
+
+std::vector<float> IndexSnapshot::LengthNorms(const std::vector<uint32_t>& lengths, double& average_length) {
+    uint64_t total = 0;
+    for (uint32_t length : lengths) {
+        total += length;
+    }
+
+    average_length = lengths.empty() || total == 0 ? 1.0 : static_cast<double>(total) / lengths.size();
+
+    std::vector<float> norms(lengths.size());
+    for (size_t i = 0; i < lengths.size(); ++i) {
+        norms[i] = static_cast<float>(lengths[i] / average_length);
+    }
+
+    return norms;
+}
+
+size_t IndexSnapshot::GetPostingsCount() const {
+    size_t count = 0;
+    for (size_t chunk = 0; chunk < postings.ChunkCount(); ++chunk) {
+        for (const auto& list : postings.ReadChunk(chunk)->postings) {
+            count += list.Size();
+        }
+    }
+
+    return count;
+}
+
+size_t IndexSnapshot::GetPositionsMemoryUsage() const {
+    size_t bytes = 0;
+    for (size_t chunk = 0; chunk < postings.ChunkCount(); ++chunk) {
+        for (const auto& list : postings.ReadChunk(chunk)->positions) {
+            bytes += list.MemoryUsage();
+        }
+    }
+
+    return bytes;
+}
+
+size_t IndexSnapshot::GetPostingsMemoryUsage() const {
+    size_t bytes = 0;
+    for (size_t chunk = 0; chunk < postings.ChunkCount(); ++chunk) {
+        for (const auto& list : postings.ReadChunk(chunk)->postings) {
+            bytes += list.MemoryUsage();
+        }
+    }
+
+    return bytes;
+}
\ No newline at end of file
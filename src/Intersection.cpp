@@ -0,0 +1,186 @@
+#include "../include/Intersection.h"
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define INTERSECTION_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+    size_t CountTrailingZeros(uint32_t bits) {
+#if defined(__GNUC__)
+        return static_cast<size_t>(__builtin_ctz(bits));
+#else
+        size_t count = 0;
+        while ((bits & 1) == 0) {
+            bits >>= 1;
+            ++count;
+        }
+        return count;
+#endif
+    }
+
+    // Дописывает к found совпадениям пересечение хвостов a[i..] и b[j..]
+    size_t MergeTail(const uint32_t* a, size_t a_size, size_t i, const uint32_t* b, size_t b_size, size_t j,
+                     uint32_t* a_positions, uint32_t* b_positions, size_t found) {
+        while (i < a_size && j < b_size) {
+            if (a[i] < b[j]) {
+                ++i;
+            } else if (b[j] < a[i]) {
+                ++j;
+            } else {
+                a_positions[found] = static_cast<uint32_t>(i++);
+                b_positions[found] = static_cast<uint32_t>(j++);
+                ++found;
+            }
+        }
+
+        return found;
+    }
+
+    size_t SimdScalar(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size,
+                      uint32_t* a_positions, uint32_t* b_positions) {
+        return MergeTail(a, a_size, 0, b, b_size, 0, a_positions, b_positions, 0);
+    }
+
+#ifdef INTERSECTION_X86
+    // Пропуск блоков b - скалярным сравнением последнего значения, поиск внутри блока - одним сравнением на равенство
+    __attribute__((target("sse2")))
+    size_t SimdSse(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size,
+                   uint32_t* a_positions, uint32_t* b_positions) {
+        size_t i = 0, j = 0, found = 0;
+
+        while (i < a_size && j + 4 <= b_size) {
+            uint32_t value = a[i];
+            if (b[j + 3] < value) {
+                j += 4;
+                continue;
+            }
+
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j));
+            __m128i equal = _mm_cmpeq_epi32(block, _mm_set1_epi32(static_cast<int>(value)));
+            auto mask = static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(equal)));
+            if (mask != 0) {
+                size_t offset = CountTrailingZeros(mask);
+                a_positions[found] = static_cast<uint32_t>(i);
+                b_positions[found] = static_cast<uint32_t>(j + offset);
+                ++found;
+                j += offset + 1;
+            }
+            ++i;
+        }
+
+        return MergeTail(a, a_size, i, b, b_size, j, a_positions, b_positions, found);
+    }
+
+    __attribute__((target("avx2")))
+    size_t SimdAvx2(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size,
+                    uint32_t* a_positions, uint32_t* b_positions) {
+        size_t i = 0, j = 0, found = 0;
+
+        while (i < a_size && j + 8 <= b_size) {
+            uint32_t value = a[i];
+            if (b[j + 7] < value) {
+                j += 8;
+                continue;
+            }
+
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j));
+            __m256i equal = _mm256_cmpeq_epi32(block, _mm256_set1_epi32(static_cast<int>(value)));
+            auto mask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(equal)));
+            if (mask != 0) {
+                size_t offset = CountTrailingZeros(mask);
+                a_positions[found] = static_cast<uint32_t>(i);
+                b_positions[found] = static_cast<uint32_t>(j + offset);
+                ++found;
+                j += offset + 1;
+            }
+            ++i;
+        }
+
+        return MergeTail(a, a_size, i, b, b_size, j, a_positions, b_positions, found);
+    }
+#endif
+
+    struct Kernel {
+        const char* name;
+        size_t (*intersect)(const uint32_t*, size_t, const uint32_t*, size_t, uint32_t*, uint32_t*);
+    };
+
+    Kernel SelectKernel() {
+#ifdef INTERSECTION_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return {"avx2", SimdAvx2};
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            return {"sse2", SimdSse};
+        }
+#endif
+        return {"scalar", SimdScalar};
+    }
+
+    const Kernel& ActiveKernel() {
+        static const Kernel kernel = SelectKernel();
+        return kernel;
+    }
+}
+
+namespace Intersection {
+    size_t Merge(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size,
+                 uint32_t* a_positions, uint32_t* b_positions) {
+        return MergeTail(a, a_size, 0, b, b_size, 0, a_positions, b_positions, 0);
+    }
+
+    size_t Gallop(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size,
+                  uint32_t* a_positions, uint32_t* b_positions) {
+        size_t found = 0, j = 0;
+
+        for (size_t i = 0; i < a_size && j < b_size; ++i) {
+            uint32_t value = a[i];
+
+            // Шаг удваивается, пока не перешагнём значение, затем двоичный поиск в последнем отрезке
+            size_t low = j, step = 1;
+            while (j + step < b_size && b[j + step] < value) {
+                low = j + step;
+                step *= 2;
+            }
+            size_t high = std::min(b_size, j + step + 1);
+
+            j = std::lower_bound(b + low, b + high, value) - b;
+            if (j < b_size && b[j] == value) {
+                a_positions[found] = static_cast<uint32_t>(i);
+                b_positions[found] = static_cast<uint32_t>(j);
+                ++found;
+                ++j;
+            }
+        }
+
+        return found;
+    }
+
+    size_t Simd(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size,
+                uint32_t* a_positions, uint32_t* b_positions) {
+        return ActiveKernel().intersect(a, a_size, b, b_size, a_positions, b_positions);
+    }
+
+    size_t Intersect(const uint32_t* a, size_t a_size, const uint32_t* b, size_t b_size,
+                     uint32_t* a_positions, uint32_t* b_positions) {
+        // Перебирается более короткий массив
+        if (a_size > b_size) {
+            return Intersect(b, b_size, a, a_size, b_positions, a_positions);
+        }
+
+        if (a_size == 0) {
+            return 0;
+        }
+        if (a_size * gallop_ratio <= b_size) {
+            return Gallop(a, a_size, b, b_size, a_positions, b_positions);
+        }
+        return Simd(a, a_size, b, b_size, a_positions, b_positions);
+    }
+
+    const char* KernelName() {
+        return ActiveKernel().name;
+    }
+}
\ No newline at end of file
@@ -1,39 +1,377 @@
 #include "../include/InvertedIndex.h"
-#include <sstream>
+#include "../include/SpimiBuilder.h"
 #include <algorithm>
 #include <cctype>
+#include <filesystem>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+    const uint32_t no_document = UINT32_MAX;
+
+    // Доля удалённых документов, после которой списки вхождений вычищаются, и их наименьшее
+    // число: проход по всем спискам делится между многими изменениями и в небольшом корпусе
+    const size_t compact_ratio = 4;
+    const size_t compact_min = 1024;
+
+    // Доля добавленных терминов, после которой они вливаются в общий словарь снимков:
+    // копия снимка копирует добавленные термины, а слияние - весь словарь
+    const size_t added_terms_ratio = 64;
+    const size_t added_terms_min = 4096;
+}
 
 void InvertedIndex::UpdateDocumentBase(std::vector<std::string> input_docs) {
-    docs.clear();
-    freq_dictionary.clear();
+    UpdateDocumentBase(std::vector<std::string_view>(input_docs.begin(), input_docs.end()));
+}
+
+void InvertedIndex::UpdateDocumentBase(const std::vector<std::string_view>& input_docs) {
+    if (build_mode == BuildMode::Spimi) {
+        BuildExternal([&input_docs](const DocumentSink& sink) {
+            for (std::string_view content : input_docs) {
+                sink(content);
+            }
+        });
+        return;
+    }
+
+    std::lock_guard<std::recursive_mutex> lock(update_mutex);
+
+    // Новый снимок строится отдельно от опубликованного, читатели его не видят
+    auto next = std::make_shared<IndexSnapshot>();
+    ResetDocumentIds(*next, input_docs.size());
+
+    ThreadPool& workers = pool ? *pool : ThreadPool::Shared();
+    std::vector<PostingList> postings;
+    std::vector<PositionList> positions;
+    if (build_mode == BuildMode::Locked) {
+        BuildLocked(workers, input_docs, *next, postings);
+        if (store_positions) {
+            BuildPositions(workers, input_docs, *next, postings, positions);
+        }
+    } else {
+        BuildSharded(workers, input_docs, *next, postings, positions);
+    }
+    next->postings = PostingTable(std::move(postings), std::move(positions), store_positions);
+
+    working = std::move(next);
+    FinishEdit();
+}
+
+void InvertedIndex::UpdateDocumentBase(const DocumentSource& source) {
+    if (build_mode == BuildMode::Spimi) {
+        BuildExternal(source);
+        return;
+    }
+
+    std::vector<std::string> input_docs;
+    source([&input_docs](std::string_view content) { input_docs.emplace_back(content); });
+    UpdateDocumentBase(std::move(input_docs));
+}
+
+void InvertedIndex::BuildExternal(const DocumentSource& source) {
+    std::lock_guard<std::recursive_mutex> lock(update_mutex);
+
+    SpimiBuilder builder(memory_budget, temp_directory, store_positions);
+    source([&builder](std::string_view content) { builder.AddDocument(content); });
+    std::string path = builder.Finish();
+
+    // Отображение файла переживает его удаление (в Windows файл останется до следующего построения)
+    try {
+        Load(path);
+    } catch (...) {
+        std::error_code error;
+        std::filesystem::remove(path, error);
+        throw;
+    }
+    std::error_code error;
+    std::filesystem::remove(path, error);
+}
+
+void InvertedIndex::BeginUpdate() {
+    update_mutex.lock();
+    ++batch_depth;
+}
+
+void InvertedIndex::EndUpdate() {
+    --batch_depth;
+    FinishEdit();
+    update_mutex.unlock();
+}
+
+IndexSnapshot& InvertedIndex::Edit() {
+    // Копия разделяет с опубликованным снимком словарь и куски таблицы списков: копируются
+    // только добавленные термины, таблицы документов и куски, в списки которых дописываются вхождения
+    if (!working) {
+        working = std::make_shared<IndexSnapshot>(*Snapshot());
+    }
+
+    return *working;
+}
+
+void InvertedIndex::FinishEdit() {
+    if (batch_depth > 0 || !working) {
+        return;
+    }
+
+    working->generation = Snapshot()->generation + 1;
+    std::atomic_store(&current, std::shared_ptr<const IndexSnapshot>(std::move(working)));
+    working.reset();
+}
+
+void InvertedIndex::BuildLocked(ThreadPool& workers, const std::vector<std::string_view>& docs, IndexSnapshot& target,
+                                std::vector<PostingList>& postings) {
+    std::vector<std::vector<Entry>> lists;
+    std::vector<uint32_t> lengths(docs.size());
+
+    workers.ParallelFor(docs.size(), workers.ChunkSize(docs.size()), [&](size_t begin, size_t end) {
+        Tokenizer tokenizer;
+        for (size_t doc_id = begin; doc_id < end; ++doc_id) {
+            lengths[doc_id] = static_cast<uint32_t>(
+                    IndexDocument(doc_id, docs[doc_id], tokenizer, *target.dictionary, lists));
+        }
+    });
+    SetDocumentLengths(target, lengths);
+
+    postings.resize(lists.size());
+    workers.ParallelFor(lists.size(), workers.ChunkSize(lists.size()), [&](size_t begin, size_t end) {
+        for (size_t id = begin; id < end; ++id) {
+            std::sort(lists[id].begin(), lists[id].end(),
+                      [](const Entry& a, const Entry& b) { return a.doc_id < b.doc_id; });
+            postings[id] = PostingList(lists[id]);
+            std::vector<Entry>().swap(lists[id]);
+        }
+    });
+}
+
+void InvertedIndex::BuildSharded(ThreadPool& workers, const std::vector<std::string_view>& docs, IndexSnapshot& target,
+                                 std::vector<PostingList>& postings, std::vector<PositionList>& positions) {
+    size_t chunk_size = workers.ChunkSize(docs.size());
+    size_t chunk_count = (docs.size() + chunk_size - 1) / chunk_size;
+    size_t shard_count = workers.Size() * 4;
+    bool with_positions = store_positions;
+
+    // Каждый кусок документов пишет только в свои словари, поэтому блокировки не нужны,
+    // а документы куска идут по возрастанию doc_id - списки вхождений уже упорядочены
+    std::vector<std::vector<LocalDictionary>> partials(chunk_count, std::vector<LocalDictionary>(shard_count));
+    std::vector<uint32_t> lengths(docs.size());
+
+    workers.ParallelFor(chunk_count, 1, [&](size_t chunk_begin, size_t chunk_end) {
+        for (size_t chunk = chunk_begin; chunk < chunk_end; ++chunk) {
+            auto& shards = partials[chunk];
+            size_t end = std::min(docs.size(), (chunk + 1) * chunk_size);
+            Tokenizer tokenizer;
+            for (auto& shard : shards) {
+                shard.with_positions = with_positions;
+            }
+
+            for (size_t doc_id = chunk * chunk_size; doc_id < end; ++doc_id) {
+                const auto& words = tokenizer.Tokenize(docs[doc_id]);
+                lengths[doc_id] = static_cast<uint32_t>(words.size());
 
-    docs = std::move(input_docs);
+                // Шард выбирается по старшим битам хеша: младшие задают ячейку в словаре шарда,
+                // и при общих младших битах все термины шарда занимали бы малую часть ячеек
+                for (size_t position = 0; position < words.size(); ++position) {
+                    std::string_view word = words[position];
+                    uint64_t hash = TermDictionary::Hash(word);
+                    shards[(hash >> 40) % shard_count].AddOccurrence(word, hash, doc_id,
+                                                                      static_cast<uint32_t>(position));
+                }
+            }
 
-    std::vector<std::thread> indexing_threads;
+            if (with_positions) {
+                for (auto& shard : shards) {
+                    shard.GroupPositions();
+                }
+            }
+        }
+    });
+    SetDocumentLengths(target, lengths);
+
+    // Слова разных шардов не пересекаются, поэтому шарды сливаются и сжимаются независимо
+    std::vector<LocalDictionary> merged(shard_count);
+    std::vector<std::vector<PostingList>> encoded(shard_count);
+    std::vector<std::vector<PositionList>> encoded_positions(shard_count);
+
+    workers.ParallelFor(shard_count, 1, [&](size_t shard_begin, size_t shard_end) {
+        std::vector<std::vector<uint32_t>> combined_ids(chunk_count);
+        std::vector<uint64_t> starts;
+        std::vector<uint32_t> flat;
+
+        for (size_t shard = shard_begin; shard < shard_end; ++shard) {
+            LocalDictionary& combined = merged[shard];
+            starts.assign(1, 0);
+
+            for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+                LocalDictionary& part = partials[chunk][shard];
+                combined_ids[chunk].resize(part.terms.Size());
+
+                for (uint32_t id = 0; id < part.terms.Size(); ++id) {
+                    std::string_view term = part.terms.Term(id);
+                    uint32_t combined_id = combined.Find(term, TermDictionary::Hash(term));
+                    combined_ids[chunk][id] = combined_id;
 
-    for (size_t doc_id = 0; doc_id < docs.size(); ++doc_id) {
-        indexing_threads.emplace_back(&InvertedIndex::IndexDocument, this, doc_id, std::ref(docs[doc_id]));
+                    auto& target = combined.postings[combined_id];
+                    if (target.empty()) {
+                        target = std::move(part.postings[id]);
+                    } else {
+                        target.insert(target.end(), part.postings[id].begin(), part.postings[id].end());
+                    }
+
+                    if (with_positions) {
+                        starts.resize(combined.postings.size() + 1, 0);
+                        starts[combined_id + 1] += part.position_starts[id + 1] - part.position_starts[id];
+                    }
+                }
+                part.terms = TermDictionary();
+                std::vector<std::vector<Entry>>().swap(part.postings);
+            }
+
+            size_t term_count = combined.postings.size();
+            if (with_positions) {
+                // Позиции раскладываются по терминам шарда в один массив: у каждого термина свой
+                // участок, а куски дописываются в него по порядку - как вхождения в списке
+                for (size_t id = 0; id < term_count; ++id) {
+                    starts[id + 1] += starts[id];
+                }
+
+                flat.resize(starts[term_count]);
+                for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+                    LocalDictionary& part = partials[chunk][shard];
+                    for (size_t id = 0; id < combined_ids[chunk].size(); ++id) {
+                        uint64_t& next = starts[combined_ids[chunk][id]];
+                        std::copy(part.positions.begin() + part.position_starts[id],
+                                  part.positions.begin() + part.position_starts[id + 1], flat.begin() + next);
+                        next += part.position_starts[id + 1] - part.position_starts[id];
+                    }
+                    part = LocalDictionary();
+                }
+            }
+
+            encoded[shard].reserve(term_count);
+            encoded_positions[shard].reserve(with_positions ? term_count : 0);
+            const uint32_t* term_positions = flat.data();
+            for (auto& entries : combined.postings) {
+                encoded[shard].emplace_back(entries);
+
+                // После раскладки starts[id] указывает на конец участка термина, то есть
+                // участки идут подряд в порядке идентификаторов
+                if (with_positions) {
+                    PositionList list;
+                    for (const Entry& entry : entries) {
+                        list.Append(term_positions, entry.count);
+                        term_positions += entry.count;
+                    }
+                    encoded_positions[shard].push_back(std::move(list));
+                }
+                std::vector<Entry>().swap(entries);
+            }
+        }
+    });
+
+    size_t term_count = 0, arena_bytes = 0;
+    for (const auto& shard : merged) {
+        term_count += shard.terms.Size();
+        arena_bytes += shard.terms.ArenaSize();
+    }
+
+    target.dictionary->Reserve(term_count, arena_bytes);
+    postings.reserve(term_count);
+    if (with_positions) {
+        positions.reserve(term_count);
     }
 
-    for (auto& thread : indexing_threads) {
-        if (thread.joinable()) {
-            thread.join();
+    for (size_t shard = 0; shard < shard_count; ++shard) {
+        for (uint32_t id = 0; id < merged[shard].terms.Size(); ++id) {
+            target.dictionary->Insert(merged[shard].terms.Term(id));
+            postings.push_back(std::move(encoded[shard][id]));
+            if (with_positions) {
+                positions.push_back(std::move(encoded_positions[shard][id]));
+            }
         }
+        merged[shard] = LocalDictionary();
     }
 }
 
-void InvertedIndex::IndexDocument(size_t doc_id, const std::string& content) {
-    auto words = SplitIntoWords(content);
+void InvertedIndex::BuildPositions(ThreadPool& workers, const std::vector<std::string_view>& docs,
+                                   const IndexSnapshot& target, const std::vector<PostingList>& postings,
+                                   std::vector<PositionList>& positions) {
+    size_t chunk_size = workers.ChunkSize(docs.size());
+    size_t chunk_count = (docs.size() + chunk_size - 1) / chunk_size;
+    size_t term_count = postings.size();
 
-    std::map<std::string, size_t> word_count;
-    for (const auto& word : words) {
+    // Слова документов как идентификаторы терминов, по кускам документов
+    std::vector<std::vector<uint32_t>> chunk_terms(chunk_count);
+    std::vector<uint32_t> lengths(docs.size());
+    workers.ParallelFor(chunk_count, 1, [&](size_t chunk_begin, size_t chunk_end) {
+        Tokenizer tokenizer;
+        for (size_t chunk = chunk_begin; chunk < chunk_end; ++chunk) {
+            size_t end = std::min(docs.size(), (chunk + 1) * chunk_size);
+            for (size_t doc_id = chunk * chunk_size; doc_id < end; ++doc_id) {
+                const auto& words = tokenizer.Tokenize(docs[doc_id]);
+                lengths[doc_id] = static_cast<uint32_t>(words.size());
+                for (std::string_view word : words) {
+                    chunk_terms[chunk].push_back(target.dictionary->Find(word));
+                }
+            }
+        }
+    });
+
+    // Позиции раскладываются по терминам в один массив: у каждого термина свой участок,
+    // внутри которого позиции идут по документам - в порядке списка вхождений
+    std::vector<uint64_t> starts(term_count + 1, 0);
+    for (const auto& terms : chunk_terms) {
+        for (uint32_t id : terms) {
+            ++starts[id + 1];
+        }
+    }
+    for (size_t id = 0; id < term_count; ++id) {
+        starts[id + 1] += starts[id];
+    }
+
+    std::vector<uint32_t> flat(starts[term_count]);
+    std::vector<uint64_t> next(starts.begin(), starts.end() - 1);
+    for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+        const uint32_t* terms = chunk_terms[chunk].data();
+        size_t end = std::min(docs.size(), (chunk + 1) * chunk_size);
+        for (size_t doc_id = chunk * chunk_size; doc_id < end; ++doc_id) {
+            for (uint32_t position = 0; position < lengths[doc_id]; ++position) {
+                flat[next[*terms++]++] = position;
+            }
+        }
+        std::vector<uint32_t>().swap(chunk_terms[chunk]);
+    }
+
+    positions.resize(term_count);
+    workers.ParallelFor(term_count, workers.ChunkSize(term_count), [&](size_t begin, size_t end) {
+        for (size_t id = begin; id < end; ++id) {
+            const uint32_t* term_positions = flat.data() + starts[id];
+            PositionList list;
+            for (PostingCursor cursor(postings[id]); !cursor.AtEnd(); cursor.Next()) {
+                list.Append(term_positions, cursor.Count());
+                term_positions += cursor.Count();
+            }
+            positions[id] = std::move(list);
+        }
+    });
+}
+
+size_t InvertedIndex::IndexDocument(size_t doc_id, std::string_view content, Tokenizer& tokenizer,
+                                    TermDictionary& dictionary, std::vector<std::vector<Entry>>& lists) {
+    const auto& words = tokenizer.Tokenize(content);
+    std::unordered_map<std::string_view, size_t> word_count;
+    for (std::string_view word : words) {
         ++word_count[word];
     }
 
     std::lock_guard<std::mutex> lock(freq_dictionary_mutex);
 
     for (const auto& [word, count] : word_count) {
-        auto& entries = freq_dictionary[word];
+        uint32_t id = dictionary.Insert(word);
+        if (id == lists.size()) {
+            lists.emplace_back();
+        }
+
+        auto& entries = lists[id];
         auto it = std::find_if(entries.begin(), entries.end(),
                                [doc_id](const Entry& entry) { return entry.doc_id == doc_id; });
 
@@ -43,32 +381,417 @@ void InvertedIndex::IndexDocument(size_t doc_id, const std::string& content) {
             entries.push_back({doc_id, count});
         }
     }
+
+    return words.size();
+}
+
+void InvertedIndex::ResetDocumentIds(IndexSnapshot& target, size_t doc_count) {
+    std::vector<uint32_t> ids(doc_count);
+    std::iota(ids.begin(), ids.end(), 0);
+    target.external_ids = ids;
+    target.internal_ids = std::move(ids);
+    target.identity_ids = true;
+
+    target.deleted = std::vector<uint64_t>((doc_count + 63) / 64, 0);
+    target.deleted_count = 0;
+    target.deleted_pending = 0;
+}
+
+void InvertedIndex::SetDocumentLengths(IndexSnapshot& target, const std::vector<uint32_t>& lengths) {
+    std::vector<float> norms = IndexSnapshot::LengthNorms(lengths, target.average_length);
+    target.minimum_norm = norms.empty() ? 0.0f : *std::min_element(norms.begin(), norms.end());
+    target.document_norms = std::move(norms);
 }
 
-std::vector<std::string> InvertedIndex::SplitIntoWords(const std::string& text) {
-    std::vector<std::string> words;
-    std::istringstream iss(text);
-    std::string word;
+void InvertedIndex::AddDocument(size_t doc_id, const std::string& content) {
+    std::lock_guard<std::recursive_mutex> lock(update_mutex);
+    IndexSnapshot& target = Edit();
+
+    if (doc_id < target.internal_ids.Size() && target.internal_ids[doc_id] != no_document) {
+        throw std::invalid_argument("document " + std::to_string(doc_id) + " is already indexed");
+    }
+
+    auto internal_id = static_cast<uint32_t>(target.external_ids.Size());
+    target.external_ids.Mutable().push_back(static_cast<uint32_t>(doc_id));
+    auto& internal_ids = target.internal_ids.Mutable();
+    if (doc_id >= internal_ids.size()) {
+        internal_ids.resize(doc_id + 1, no_document);
+    }
+    internal_ids[doc_id] = internal_id;
+    target.identity_ids = target.identity_ids && internal_id == doc_id;
+    target.deleted.Mutable().resize((target.external_ids.Size() + 63) / 64, 0);
 
-    while (iss >> word) {
-        std::transform(word.begin(), word.end(), word.begin(),
-                       [](unsigned char c) { return std::tolower(c); });
+    Tokenizer tokenizer;
+    const auto& words = tokenizer.Tokenize(content);
+    std::unordered_map<std::string_view, uint32_t> word_count;
+    for (std::string_view word : words) {
+        ++word_count[word];
+    }
+
+    // В пустой индекс первый документ добавляется с позициями, если они включены
+    auto& postings = target.postings;
+    if (postings.Size() == 0) {
+        postings.SetPositions(store_positions);
+    }
+    std::unordered_map<std::string_view, std::vector<uint32_t>> word_positions;
+    if (postings.HasPositions()) {
+        for (size_t position = 0; position < words.size(); ++position) {
+            word_positions[words[position]].push_back(static_cast<uint32_t>(position));
+        }
+    }
 
-        words.push_back(word);
+    // Средняя длина остаётся прежней до перестройки, чтобы не пересчитывать нормы остальных документов
+    if (target.average_length == 0) {
+        target.average_length = words.empty() ? 1.0 : static_cast<double>(words.size());
     }
+    float norm = static_cast<float>(words.size() / target.average_length);
+    target.minimum_norm = target.document_norms.Empty() ? norm : std::min(target.minimum_norm, norm);
+    target.document_norms.Mutable().push_back(norm);
 
-    return words;
+    for (const auto& [word, count] : word_count) {
+        uint32_t id = InsertTerm(target, word);
+        if (id == postings.Size()) {
+            postings.Add();
+        }
+        postings.MutablePostings(id).Append(internal_id, count);
+        if (postings.HasPositions()) {
+            const auto& positions = word_positions[word];
+            postings.MutablePositions(id).Append(positions.data(), positions.size());
+        }
+    }
+
+    size_t added_count = target.added_terms.Size();
+    if (added_count > added_terms_min && added_count * added_terms_ratio > target.dictionary->Size()) {
+        target.dictionary = MergedDictionary(target);
+        target.added_terms = TermDictionary();
+    }
+
+    FinishEdit();
+}
+
+uint32_t InvertedIndex::InsertTerm(IndexSnapshot& target, std::string_view term) {
+    // Общий словарь не меняется: новый термин попадает в added_terms
+    uint32_t id = target.dictionary->Find(term);
+    if (id != TermDictionary::npos) {
+        return id;
+    }
+
+    return static_cast<uint32_t>(target.dictionary->Size() + target.added_terms.Insert(term));
+}
+
+std::shared_ptr<TermDictionary> InvertedIndex::MergedDictionary(const IndexSnapshot& source) {
+    // Копия подключённого словаря разделяет таблицы с сегментом до первого нового термина
+    auto merged = std::make_shared<TermDictionary>(*source.dictionary);
+    const TermDictionary& added = source.added_terms;
+    if (added.Size() > 0) {
+        merged->Reserve(merged->Size() + added.Size(), merged->ArenaSize() + added.ArenaSize());
+    }
+    for (uint32_t id = 0; id < added.Size(); ++id) {
+        merged->Insert(added.Term(id));
+    }
+
+    return merged;
+}
+
+void InvertedIndex::UpdateDocument(size_t doc_id, const std::string& content) {
+    // Читатели не должны увидеть момент, когда старая версия удалена, а новая ещё не добавлена
+    BeginUpdate();
+    try {
+        RemoveDocument(doc_id);
+        AddDocument(doc_id, content);
+    } catch (...) {
+        EndUpdate();
+        throw;
+    }
+    EndUpdate();
+}
+
+bool InvertedIndex::RemoveDocument(size_t doc_id) {
+    std::lock_guard<std::recursive_mutex> lock(update_mutex);
+
+    auto snapshot = Snapshot();
+    const IndexSnapshot& visible = working ? *working : *snapshot;
+    if (doc_id >= visible.internal_ids.Size() || visible.internal_ids[doc_id] == no_document) {
+        return false;
+    }
+
+    IndexSnapshot& target = Edit();
+    uint32_t internal_id = target.internal_ids[doc_id];
+    target.internal_ids.Mutable()[doc_id] = no_document;
+    target.deleted.Mutable()[internal_id >> 6] |= 1ull << (internal_id & 63);
+    ++target.deleted_count;
+    ++target.deleted_pending;
+
+    if (target.deleted_pending >= compact_min && target.deleted_pending * compact_ratio > target.GetDocumentCount()) {
+        CompactSnapshot(target);
+    }
+
+    FinishEdit();
+    return true;
+}
+
+void InvertedIndex::Compact() {
+    std::lock_guard<std::recursive_mutex> lock(update_mutex);
+
+    if ((working ? working->deleted_pending : Snapshot()->deleted_pending) == 0) {
+        return;
+    }
+
+    CompactSnapshot(Edit());
+    FinishEdit();
+}
+
+void InvertedIndex::CompactSnapshot(IndexSnapshot& target) {
+    if (target.deleted_pending == 0) {
+        return;
+    }
+
+    auto& postings = target.postings;
+    const uint64_t* deleted = target.deleted.Data();
+    size_t chunk_count = postings.ChunkCount();
+
+    // Потоки делят таблицу по её кускам: изменяемый кусок копируется целиком
+    ThreadPool& workers = pool ? *pool : ThreadPool::Shared();
+    workers.ParallelFor(chunk_count, workers.ChunkSize(chunk_count), [&](size_t chunk_begin, size_t chunk_end) {
+        std::vector<Entry> live;
+        std::vector<uint32_t> positions;
+
+        for (size_t chunk = chunk_begin; chunk < chunk_end; ++chunk) {
+            // Прежние списки куска остаются живы, пока кусок в таблице заменяется копией
+            auto lists = postings.ReadChunk(chunk);
+            for (size_t index = 0; index < lists->postings.size(); ++index) {
+                const PostingList& list = lists->postings[index];
+                auto id = static_cast<uint32_t>(chunk * PostingTable::chunk_size + index);
+                live.clear();
+
+                bool changed = false;
+                for (PostingCursor cursor(list); !cursor.AtEnd(); cursor.Next()) {
+                    if (IsDocumentDeleted(deleted, cursor.DocId())) {
+                        changed = true;
+                    } else {
+                        live.push_back({cursor.DocId(), cursor.Count()});
+                    }
+                }
+
+                if (!changed) {
+                    continue;
+                }
+
+                if (postings.HasPositions()) {
+                    PositionList kept;
+                    for (PostingCursor cursor(list); !cursor.AtEnd(); cursor.Next()) {
+                        if (!IsDocumentDeleted(deleted, cursor.DocId())) {
+                            lists->positions[index].Read(cursor.BlockIndex(), cursor.BlockPosition(),
+                                                         cursor.BlockCounts(), positions);
+                            kept.Append(positions.data(), positions.size());
+                        }
+                    }
+                    postings.MutablePositions(id) = std::move(kept);
+                }
+                postings.MutablePostings(id) = PostingList(live);
+            }
+        }
+    });
+
+    target.deleted_pending = 0;
 }
 
 std::vector<Entry> InvertedIndex::GetWordCount(const std::string& word) {
-    std::string lower_word = word;
-    std::transform(lower_word.begin(), lower_word.end(), lower_word.begin(),
-                   [](unsigned char c) { return std::tolower(c); });
+    auto snapshot = Snapshot();
+    auto view = snapshot->GetPostings(word);
 
-    auto it = freq_dictionary.find(lower_word);
-    if (it != freq_dictionary.end()) {
-        return it->second;
+    std::vector<Entry> entries;
+    entries.reserve(view.Size());
+    entries.assign(view.begin(), view.end());
+
+    if (!snapshot->identity_ids) {
+        std::sort(entries.begin(), entries.end(),
+                  [](const Entry& a, const Entry& b) { return a.doc_id < b.doc_id; });
     }
+    return entries;
+}
+
+void InvertedIndex::Save(const std::string& path, const std::vector<SourceFile>& sources) const {
+    using namespace IndexSegment;
+
+    auto snapshot = Snapshot();
+    const PostingTable& postings = snapshot->postings;
+
+    // В файле словарь один, поэтому добавленные термины дописываются в копию общего
+    std::shared_ptr<const TermDictionary> merged;
+    if (snapshot->added_terms.Size() > 0) {
+        merged = MergedDictionary(*snapshot);
+    }
+    const TermDictionary& dictionary = merged ? *merged : *snapshot->dictionary;
+
+    Writer writer(path);
+    Header& header = writer.GetHeader();
+    header.term_count = dictionary.Size();
+    header.slot_count = dictionary.SlotCount();
+    header.document_count = snapshot->external_ids.Size();
+    header.internal_id_count = snapshot->internal_ids.Size();
+    header.deleted_count = snapshot->deleted_count;
+    header.deleted_pending = snapshot->deleted_pending;
+    header.average_length = snapshot->average_length;
+    header.minimum_norm = snapshot->minimum_norm;
+    header.identity_ids = snapshot->identity_ids ? 1 : 0;
+
+    writer.WriteSection(DictionarySlots, dictionary.SlotData(), dictionary.SlotCount() * sizeof(TermDictionary::Slot));
+    writer.WriteSection(TermOffsets, dictionary.OffsetData(), (dictionary.Size() + 1) * sizeof(uint64_t));
+    writer.WriteSection(TermArena, dictionary.ArenaData(), dictionary.ArenaSize());
+
+    std::vector<TermList> lists;
+    lists.reserve(postings.Size());
+    uint64_t block_total = 0, word_total = 0, group_total = 0;
+    for (size_t chunk = 0; chunk < postings.ChunkCount(); ++chunk) {
+        auto part = postings.ReadChunk(chunk);
+        for (size_t index = 0; index < part->postings.size(); ++index) {
+            const PostingList& list = part->postings[index];
+            lists.push_back({block_total, word_total, static_cast<uint32_t>(list.BlockCount()),
+                             static_cast<uint32_t>(list.WordCount()), static_cast<uint32_t>(list.Size()),
+                             list.MaxCount(), group_total});
+            block_total += list.BlockCount();
+            word_total += list.WordCount();
+            group_total += postings.HasPositions() ? part->positions[index].GroupCount() : 0;
+        }
+    }
+    writer.WriteSection(TermLists, lists.data(), lists.size() * sizeof(TermList));
+
+    writer.BeginSection(Blocks);
+    for (size_t chunk = 0; chunk < postings.ChunkCount(); ++chunk) {
+        for (const auto& list : postings.ReadChunk(chunk)->postings) {
+            writer.Write(list.BlockData(), list.BlockCount() * sizeof(PostingBlock));
+        }
+    }
+    writer.EndSection();
+
+    writer.BeginSection(Words);
+    for (size_t chunk = 0; chunk < postings.ChunkCount(); ++chunk) {
+        for (const auto& list : postings.ReadChunk(chunk)->postings) {
+            writer.Write(list.WordData(), list.WordCount() * sizeof(uint32_t));
+        }
+    }
+    writer.EndSection();
+
+    writer.WriteSection(ExternalIds, snapshot->external_ids.Data(), snapshot->external_ids.Size() * sizeof(uint32_t));
+    writer.WriteSection(InternalIds, snapshot->internal_ids.Data(), snapshot->internal_ids.Size() * sizeof(uint32_t));
+    writer.WriteSection(DeletedDocuments, snapshot->deleted.Data(), snapshot->deleted.Size() * sizeof(uint64_t));
+    writer.WriteSection(DocumentNorms, snapshot->document_norms.Data(), snapshot->document_norms.Size() * sizeof(float));
+
+    if (postings.HasPositions()) {
+        writer.BeginSection(PositionOffsets);
+        uint64_t data_total = 0;
+        std::vector<uint64_t> offsets;
+        for (size_t chunk = 0; chunk < postings.ChunkCount(); ++chunk) {
+            for (const auto& list : postings.ReadChunk(chunk)->positions) {
+                offsets.clear();
+                for (size_t group = 0; group < list.GroupCount(); ++group) {
+                    offsets.push_back(data_total + list.GroupOffset(group));
+                }
+                writer.Write(offsets.data(), offsets.size() * sizeof(uint64_t));
+                data_total += list.DataSize();
+            }
+        }
+        writer.EndSection();
+
+        writer.BeginSection(PositionData);
+        for (size_t chunk = 0; chunk < postings.ChunkCount(); ++chunk) {
+            for (const auto& list : postings.ReadChunk(chunk)->positions) {
+                writer.Write(list.Data(), list.DataSize());
+            }
+        }
+        writer.EndSection();
+    } else {
+        // Пустые секции тоже должны лежать внутри файла, иначе сегмент не откроется
+        writer.WriteSection(PositionOffsets, nullptr, 0);
+        writer.WriteSection(PositionData, nullptr, 0);
+    }
+
+    std::string encoded_sources = EncodeSources(sources);
+    writer.WriteSection(SourceFiles, encoded_sources.data(), encoded_sources.size());
+
+    writer.Commit();
+}
+
+std::vector<SourceFile> InvertedIndex::Load(const std::string& path) {
+    using namespace IndexSegment;
+
+    // Таблицы подключаются к отображению без копирования, а списки терминов собираются
+    // и проверяются при первом обращении к ним, поэтому открытие не зависит от размера
+    // словаря и списков. Сразу проверяются только таблицы документов и исходных файлов.
+    Reader reader(path);
+    const Header& header = reader.GetHeader();
+    size_t term_count = header.term_count;
+    size_t slot_count = header.slot_count;
+    size_t document_count = header.document_count;
+
+    // Пробирование остановится только на пустой ячейке, поэтому ячеек должно быть больше терминов
+    if ((slot_count & (slot_count - 1)) != 0 || (term_count > 0 && slot_count <= term_count)) {
+        throw std::runtime_error("index segment dictionary is malformed");
+    }
+
+    auto slots = reader.SectionArray<TermDictionary::Slot>(DictionarySlots, slot_count);
+    auto term_offsets = reader.SectionArray<uint64_t>(TermOffsets, term_count + 1);
+    auto external = reader.SectionArray<uint32_t>(ExternalIds, document_count);
+    auto internal = reader.SectionArray<uint32_t>(InternalIds, header.internal_id_count);
+    auto deleted_bits = reader.SectionArray<uint64_t>(DeletedDocuments, (document_count + 63) / 64);
+    auto norms = reader.SectionArray<float>(DocumentNorms, document_count);
+    auto postings = PostingTable::Attach(reader, term_count);
+
+    if (term_offsets[0] != 0 || term_offsets[term_count] != reader.SectionSize(TermArena)) {
+        throw std::runtime_error("index segment dictionary is malformed");
+    }
+
+    // Номера документов из этих таблиц служат индексами в другие таблицы без проверок
+    for (Section section : {ExternalIds, InternalIds, DeletedDocuments, DocumentNorms}) {
+        reader.VerifySection(section);
+    }
+    size_t deleted_total = 0;
+    for (size_t internal_id = 0; internal_id < document_count; ++internal_id) {
+        deleted_total += IsDocumentDeleted(deleted_bits, static_cast<uint32_t>(internal_id));
+    }
+    if (document_count >= no_document || deleted_total != header.deleted_count
+        || header.deleted_pending > header.deleted_count) {
+        throw std::runtime_error("index segment document table is malformed");
+    }
+
+    size_t mapped_total = 0;
+    for (size_t doc_id = 0; doc_id < header.internal_id_count; ++doc_id) {
+        uint32_t internal_id = internal[doc_id];
+        if (internal_id == no_document) {
+            continue;
+        }
+        if (internal_id >= document_count || IsDocumentDeleted(deleted_bits, internal_id)
+            || (header.identity_ids != 0 ? internal_id : external[internal_id]) != doc_id) {
+            throw std::runtime_error("index segment document table is malformed");
+        }
+        ++mapped_total;
+    }
+    if (mapped_total != document_count - deleted_total) {
+        throw std::runtime_error("index segment document table is malformed");
+    }
+
+    reader.VerifySection(SourceFiles);
+    auto sources = DecodeSources(reader.SectionData(SourceFiles), reader.SectionSize(SourceFiles));
+
+    auto next = std::make_shared<IndexSnapshot>();
+    next->dictionary->Attach(slots, slot_count, term_offsets, term_count, reader.SectionData(TermArena));
+    next->postings = std::move(postings);
+
+    next->external_ids.Attach(external, document_count);
+    next->internal_ids.Attach(internal, header.internal_id_count);
+    next->identity_ids = header.identity_ids != 0;
+    next->deleted.Attach(deleted_bits, (document_count + 63) / 64);
+    next->deleted_count = header.deleted_count;
+    next->deleted_pending = header.deleted_pending;
+    next->document_norms.Attach(norms, document_count);
+    next->average_length = header.average_length;
+    next->minimum_norm = header.minimum_norm;
+    next->segment = reader.File();
+
+    std::lock_guard<std::recursive_mutex> lock(update_mutex);
+    working = std::move(next);
+    FinishEdit();
 
-    return {};
+    return sources;
 }
\ No newline at end of file
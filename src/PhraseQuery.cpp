@@ -0,0 +1,172 @@
+#include "../include/PhraseQuery.h"
+#include <algorithm>
+
+namespace {
+    // Оператор близости NEAR/k (слова уже в нижнем регистре); false - слово не оператор
+    bool ParseNear(std::string_view word, uint32_t& distance) {
+        const std::string_view prefix = "near/";
+        if (word.size() <= prefix.size() || word.substr(0, prefix.size()) != prefix || word.size() > prefix.size() + 9) {
+            return false;
+        }
+
+        distance = 0;
+        for (char c : word.substr(prefix.size())) {
+            if (c < '0' || c > '9') {
+                return false;
+            }
+            distance = distance * 10 + static_cast<uint32_t>(c - '0');
+        }
+        return true;
+    }
+}
+
+void ParsedQuery::Parse(std::string_view query, Tokenizer& tokenizer) {
+    text.assign(query.data(), query.size());
+    quotes.clear();
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '"') {
+            quotes.push_back(i);
+            text[i] = ' ';
+        }
+    }
+
+    words.clear();
+    constraints.clear();
+    constraint_words.clear();
+
+    const auto& tokens = tokenizer.Tokenize(text);
+    size_t quote = 0;
+    size_t open_phrase = SIZE_MAX; // номер открытой фразы (кавычки перед словом), SIZE_MAX - вне кавычек
+    size_t phrase_start = 0;       // начало слов текущей фразы в constraint_words
+    bool previous_plain = false;   // предыдущее слово - обычное слово вне кавычек
+    bool near_pending = false;     // после него стоял оператор NEAR
+    uint32_t near_distance = 0;
+
+    auto close_phrase = [&]() {
+        size_t length = constraint_words.size() - phrase_start;
+        if (length >= 2) {
+            constraints.push_back({static_cast<uint32_t>(phrase_start), static_cast<uint32_t>(length), 0});
+        } else {
+            constraint_words.resize(phrase_start);
+        }
+    };
+
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        std::string_view token = tokens[i];
+        size_t offset = tokenizer.Offset(token);
+        size_t quotes_before = quote;
+        while (quotes_before < quotes.size() && quotes[quotes_before] < offset) {
+            ++quotes_before;
+        }
+
+        // Слово в кавычках: нечётное число кавычек перед ним
+        size_t phrase = quotes_before % 2 == 1 ? quotes_before : SIZE_MAX;
+        if (phrase != open_phrase) {
+            if (open_phrase != SIZE_MAX) {
+                close_phrase();
+            }
+            open_phrase = phrase;
+            phrase_start = constraint_words.size();
+        }
+        quote = quotes_before;
+
+        uint32_t distance;
+        if (phrase == SIZE_MAX && ParseNear(token, distance)) {
+            near_pending = previous_plain;
+            near_distance = std::max<uint32_t>(distance, 1);
+            previous_plain = false;
+            continue;
+        }
+
+        // Операнды NEAR - отдельные слова вне кавычек, иначе оператор игнорируется
+        if (phrase == SIZE_MAX && near_pending) {
+            constraints.push_back({static_cast<uint32_t>(constraint_words.size()), 2, near_distance});
+            constraint_words.push_back(words.back());
+            constraint_words.push_back(token);
+        }
+        near_pending = false;
+        previous_plain = phrase == SIZE_MAX;
+
+        words.push_back(token);
+        if (phrase != SIZE_MAX) {
+            constraint_words.push_back(token);
+        }
+    }
+
+    if (open_phrase != SIZE_MAX) {
+        close_phrase();
+    }
+}
+
+bool MatchPhrase(const std::vector<uint32_t>* const* positions, size_t length) {
+    // Опорное слово - с наименьшим числом позиций. Его позиции идут по возрастанию,
+    // поэтому указатели в списках остальных слов только продвигаются вперёд.
+    size_t anchor = 0;
+    for (size_t i = 1; i < length; ++i) {
+        if (positions[i]->size() < positions[anchor]->size()) {
+            anchor = i;
+        }
+    }
+
+    size_t next[16] = {};
+    std::vector<size_t> long_next;
+    size_t* cursor = next;
+    if (length > 16) {
+        long_next.assign(length, 0);
+        cursor = long_next.data();
+    }
+
+    for (uint32_t position : *positions[anchor]) {
+        if (position < anchor) {
+            continue;
+        }
+
+        uint32_t start = position - static_cast<uint32_t>(anchor);
+        bool matched = true;
+        for (size_t i = 0; i < length && matched; ++i) {
+            if (i == anchor) {
+                continue;
+            }
+
+            const std::vector<uint32_t>& word = *positions[i];
+            uint32_t target = start + static_cast<uint32_t>(i);
+            while (cursor[i] < word.size() && word[cursor[i]] < target) {
+                ++cursor[i];
+            }
+            if (cursor[i] == word.size()) {
+                return false;
+            }
+            matched = word[cursor[i]] == target;
+        }
+        if (matched) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool MatchNear(const std::vector<uint32_t>& first, const std::vector<uint32_t>& second, uint32_t distance) {
+    size_t i = 0, j = 0;
+    while (i < first.size() && j < second.size()) {
+        // Совпадение позиций возможно, только если это одно и то же слово
+        if (first[i] == second[j]) {
+            ++j;
+            continue;
+        }
+
+        uint32_t low = std::min(first[i], second[j]);
+        uint32_t high = std::max(first[i], second[j]);
+        if (high - low <= distance) {
+            return true;
+        }
+
+        if (first[i] < second[j]) {
+            ++i;
+        } else {
+            ++j;
+        }
+    }
+
+    return false;
+}
\ No newline at end of file
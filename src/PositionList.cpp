@@ -0,0 +1,188 @@
+#include "../include/PositionList.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    size_t PopCount(uint64_t bits) {
+#if defined(__GNUC__)
+        return static_cast<size_t>(__builtin_popcountll(bits));
+#else
+        size_t count = 0;
+        for (; bits != 0; bits &= bits - 1) {
+            ++count;
+        }
+        return count;
+#endif
+    }
+
+    // Пропускает skip значений varint: у последнего байта значения старший бит сброшен,
+    // поэтому байты считаются по 8 за раз, пока значений для пропуска не меньше восьми.
+    // nullptr - данные кончились раньше.
+    const uint8_t* SkipValues(const uint8_t* in, const uint8_t* end, size_t skip) {
+        const uint64_t high_bits = 0x8080808080808080ull;
+        while (skip >= 8 && end - in >= 8) {
+            uint64_t word;
+            std::memcpy(&word, in, sizeof(word));
+            size_t terminators = PopCount(~word & high_bits);
+            if (terminators > skip) {
+                break;
+            }
+            skip -= terminators;
+            in += 8;
+        }
+
+        for (; skip > 0; ++in) {
+            if (in == end) {
+                return nullptr;
+            }
+            skip -= (*in & 0x80) == 0;
+        }
+        return in;
+    }
+}
+
+PositionList PositionList::Attach(const uint64_t* offsets, size_t group_count, const uint8_t* base,
+                                  uint64_t end, size_t size) {
+    PositionList list;
+    list.offsets = offsets;
+    list.group_count = group_count;
+    list.offset_base = group_count > 0 ? offsets[0] : end;
+    list.data = base + list.offset_base;
+    list.data_size = static_cast<size_t>(end - list.offset_base);
+    list.size = size;
+    return list;
+}
+
+PositionList::Storage& PositionList::MakeWritable() {
+    if (!storage || storage.use_count() > 1) {
+        auto copy = std::make_shared<Storage>();
+        copy->offsets.reserve(group_count);
+        for (size_t i = 0; i < group_count; ++i) {
+            copy->offsets.push_back(GroupOffset(i));
+        }
+        copy->data.assign(data, data + data_size);
+        storage = std::move(copy);
+        offset_base = 0;
+        Sync();
+    }
+
+    return *storage;
+}
+
+void PositionList::Sync() {
+    offsets = storage->offsets.data();
+    group_count = storage->offsets.size();
+    data = storage->data.data();
+    data_size = storage->data.size();
+}
+
+void PositionList::Append(const uint32_t* positions, size_t count) {
+    Storage& own = MakeWritable();
+
+    if (size % group_size == 0) {
+        own.offsets.push_back(own.data.size());
+    }
+    Encode(positions, count, own.data);
+    ++size;
+    Sync();
+}
+
+void PositionList::Encode(const uint32_t* positions, size_t count, std::vector<uint8_t>& out) {
+    uint32_t previous = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t value = positions[i] - previous;
+        previous = positions[i];
+
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+}
+
+void PositionList::Read(size_t block, size_t index, const uint32_t* counts, std::vector<uint32_t>& positions) const {
+    ReadPosition from;
+    Read(block, index, counts, positions, from);
+}
+
+void PositionList::Read(size_t block, size_t index, const uint32_t* counts, std::vector<uint32_t>& positions,
+                        ReadPosition& from) const {
+    size_t block_start = block * block_size;
+    size_t posting = block_start + index;
+    size_t group = posting / group_size;
+    if (from.group != group || from.posting > posting) {
+        from.group = group;
+        from.posting = group * group_size;
+        from.offset = GroupOffset(group);
+    }
+
+    // Данные подключённого списка проверяются при чтении: смещения групп и длины
+    // значений в сегменте могли быть повреждены
+    if (from.offset > data_size) {
+        throw std::runtime_error("index segment positions are malformed");
+    }
+
+    // Позиции предыдущих вхождений группы пропускаются по последним байтам varint
+    size_t skip = 0;
+    for (size_t i = from.posting; i < posting; ++i) {
+        skip += counts[i - block_start];
+    }
+    const uint8_t* in = SkipValues(data + from.offset, data + data_size, skip);
+    if (!in) {
+        throw std::runtime_error("index segment positions are malformed");
+    }
+
+    size_t count = counts[index];
+    positions.resize(count);
+    uint32_t* out = positions.data();
+    const uint8_t* end = data + data_size;
+    uint32_t previous = 0;
+    size_t i = 0;
+
+    // Разности позиций обычно меньше 128: восемь однобайтовых значений подряд
+    // распознаются по одному слову без проверки каждого байта
+    const uint64_t high_bits = 0x8080808080808080ull;
+    while (count - i >= 8 && end - in >= 8) {
+        uint64_t word;
+        std::memcpy(&word, in, sizeof(word));
+        if ((word & high_bits) != 0) {
+            break;
+        }
+        for (size_t k = 0; k < 8; ++k) {
+            previous += static_cast<uint32_t>(in[k]);
+            out[i + k] = previous;
+        }
+        in += 8;
+        i += 8;
+    }
+
+    for (; i < count; ++i) {
+        uint32_t value = 0;
+        for (uint32_t shift = 0;; shift += 7) {
+            if (in == end || shift > 28) {
+                throw std::runtime_error("index segment positions are malformed");
+            }
+            uint8_t byte = *in++;
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        previous += value;
+        out[i] = previous;
+    }
+
+    from.posting = posting + 1;
+    from.offset = static_cast<uint64_t>(in - data);
+}
+
+size_t PositionList::MemoryUsage() const {
+    if (!storage) {
+        return sizeof(PositionList) + group_count * sizeof(uint64_t) + data_size;
+    }
+
+    return sizeof(PositionList)
+           + storage->offsets.capacity() * sizeof(uint64_t)
+           + storage->data.capacity();
+}
\ No newline at end of file
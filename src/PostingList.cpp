@@ -0,0 +1,219 @@
+#include "../include/PostingList.h"
+#include <algorithm>
+
+PostingList::PostingList(const std::vector<Entry>& entries) {
+    if (entries.empty()) {
+        return;
+    }
+
+    Storage& own = MakeWritable();
+    own.blocks.reserve((entries.size() + block_size - 1) / block_size);
+
+    uint32_t doc_ids[block_size];
+    uint32_t counts[block_size];
+
+    for (size_t begin = 0; begin < entries.size(); begin += block_size) {
+        size_t block_length = std::min(block_size, entries.size() - begin);
+        for (size_t i = 0; i < block_length; ++i) {
+            doc_ids[i] = static_cast<uint32_t>(entries[begin + i].doc_id);
+            counts[i] = static_cast<uint32_t>(entries[begin + i].count);
+        }
+
+        AppendBlock(doc_ids, counts, block_length);
+    }
+
+    own.data.shrink_to_fit();
+    Sync();
+}
+
+PostingList PostingList::Attach(const PostingBlock* block_data, size_t block_count,
+                                const uint32_t* word_data, size_t word_count, size_t size, uint32_t max_count) {
+    PostingList list;
+    list.block_data = block_data;
+    list.block_count = static_cast<uint32_t>(block_count);
+    list.word_data = word_data;
+    list.word_count = static_cast<uint32_t>(word_count);
+    list.size = static_cast<uint32_t>(size);
+    list.max_count = max_count;
+    return list;
+}
+
+PostingList::Storage& PostingList::MakeWritable() {
+    // use_count() == 1: данные доступны только через этот список, другие потоки их не видят
+    if (!storage || storage.use_count() > 1) {
+        auto copy = std::make_shared<Storage>();
+        copy->blocks.assign(block_data, block_data + block_count);
+        copy->data.assign(word_data, word_data + word_count);
+        storage = std::move(copy);
+        Sync();
+    }
+
+    return *storage;
+}
+
+void PostingList::Sync() {
+    block_data = storage->blocks.data();
+    block_count = static_cast<uint32_t>(storage->blocks.size());
+    word_data = storage->data.data();
+    word_count = static_cast<uint32_t>(storage->data.size());
+}
+
+void PostingList::Append(uint32_t doc_id, uint32_t count) {
+    Storage& own = MakeWritable();
+
+    uint32_t doc_ids[block_size];
+    uint32_t counts[block_size];
+    size_t block_length = 0;
+
+    // Неполный последний блок распаковывается и упаковывается заново вместе с новым вхождением
+    if (!own.blocks.empty() && own.blocks.back().size < block_size) {
+        block_length = DecodeBlock(own.blocks.size() - 1, doc_ids, counts);
+        own.data.resize(own.blocks.back().offset);
+        size -= static_cast<uint32_t>(block_length);
+        own.blocks.pop_back();
+    }
+
+    doc_ids[block_length] = doc_id;
+    counts[block_length] = count;
+    AppendBlock(doc_ids, counts, block_length + 1);
+    Sync();
+}
+
+void PostingList::AppendBlock(const uint32_t* doc_ids, const uint32_t* counts, size_t block_length) {
+    std::vector<PostingBlock>& blocks = storage->blocks;
+    std::vector<uint32_t>& data = storage->data;
+
+    PostingBlock block{};
+    size_t offset = data.size();
+    data.resize(offset + max_block_words);
+    size_t words = EncodeBlock(doc_ids, counts, block_length, blocks.empty() ? 0 : blocks.back().last_doc,
+                               block, data.data() + offset);
+    data.resize(offset + words);
+
+    block.offset = static_cast<uint32_t>(offset);
+    blocks.push_back(block);
+    size += static_cast<uint32_t>(block_length);
+    max_count = std::max(max_count, block.max_count);
+}
+
+size_t PostingList::EncodeBlock(const uint32_t* doc_ids, const uint32_t* counts, size_t block_length,
+                                uint32_t previous_doc, PostingBlock& block, uint32_t* out) {
+    uint32_t deltas[block_size];
+    uint32_t count_values[block_size];
+    uint32_t previous = previous_doc;
+    uint32_t max_count = 0;
+
+    for (size_t i = 0; i < block_length; ++i) {
+        deltas[i] = doc_ids[i] - previous;
+        count_values[i] = counts[i] - 1;
+        previous = doc_ids[i];
+        max_count = std::max(max_count, counts[i]);
+    }
+
+    block.last_doc = previous;
+    block.max_count = max_count;
+    block.doc_bits = static_cast<uint8_t>(BitPacking::RequiredBits(deltas, block_length));
+    block.count_bits = static_cast<uint8_t>(BitPacking::RequiredBits(count_values, block_length));
+    block.size = static_cast<uint16_t>(block_length);
+
+    size_t doc_words = BitPacking::PackedWords(block.doc_bits, block_length);
+    BitPacking::Pack(deltas, block_length, block.doc_bits, out);
+    BitPacking::Pack(count_values, block_length, block.count_bits, out + doc_words);
+
+    return doc_words + BitPacking::PackedWords(block.count_bits, block_length);
+}
+
+size_t PostingList::DecodeBlock(size_t index, uint32_t* doc_ids, uint32_t* counts) const {
+    const PostingBlock& block = block_data[index];
+    uint32_t base = index == 0 ? 0 : block_data[index - 1].last_doc;
+    const uint32_t* packed = word_data + block.offset;
+
+    BitPacking::UnpackDelta(packed, block.size, block.doc_bits, base, doc_ids);
+    BitPacking::Unpack(packed + BitPacking::PackedWords(block.doc_bits, block.size), block.size, block.count_bits, 1, counts);
+
+    return block.size;
+}
+
+bool PostingList::IsWellFormed(size_t document_count) const {
+    uint32_t doc_ids[block_size];
+    uint32_t counts[block_size];
+    int64_t previous = -1;
+    size_t total = 0;
+
+    for (size_t index = 0; index < block_count; ++index) {
+        const PostingBlock& block = block_data[index];
+
+        // Неполным может быть только последний блок: по номеру блока курсор и позиции
+        // находят номер вхождения в списке
+        bool last = index + 1 == block_count;
+        if (block.size == 0 || block.size > block_size || (!last && block.size != block_size)
+            || block.doc_bits > 32 || block.count_bits > 32 || block.max_count > max_count
+            || block.offset > word_count
+            || BitPacking::PackedWords(block.doc_bits, block.size) + BitPacking::PackedWords(block.count_bits, block.size)
+               > word_count - block.offset) {
+            return false;
+        }
+
+        // Переполнение при восстановлении из разностей нарушает возрастание doc_id
+        DecodeBlock(index, doc_ids, counts);
+        for (size_t i = 0; i < block.size; ++i) {
+            if (doc_ids[i] <= previous || doc_ids[i] >= document_count || counts[i] == 0 || counts[i] > block.max_count) {
+                return false;
+            }
+            previous = doc_ids[i];
+        }
+        if (previous != block.last_doc) {
+            return false;
+        }
+        total += block.size;
+    }
+
+    return total == size;
+}
+
+size_t PostingList::MemoryUsage() const {
+    if (!storage) {
+        return sizeof(PostingList)
+               + block_count * sizeof(PostingBlock)
+               + word_count * sizeof(uint32_t);
+    }
+
+    return sizeof(PostingList)
+           + storage->blocks.capacity() * sizeof(PostingBlock)
+           + storage->data.capacity() * sizeof(uint32_t);
+}
+
+void PostingCursor::SkipDeleted() {
+    while (!AtEnd() && IsDeleted(DocId())) {
+        if (++position == length) {
+            LoadBlock(block + 1);
+        }
+    }
+}
+
+void PostingCursor::LoadBlock(size_t index) {
+    block = index;
+    position = 0;
+    length = index < list->BlockCount() ? list->DecodeBlock(index, doc_ids, counts) : 0;
+}
+
+void PostingCursor::AdvanceTo(uint32_t target) {
+    if (AtEnd() || doc_ids[position] >= target) {
+        return;
+    }
+
+    if (list->Block(block).last_doc < target) {
+        size_t next = block + 1;
+        while (next < list->BlockCount() && list->Block(next).last_doc < target) {
+            ++next;
+        }
+
+        LoadBlock(next);
+        if (AtEnd()) {
+            return;
+        }
+    }
+
+    position = std::lower_bound(doc_ids + position, doc_ids + length, target) - doc_ids;
+    SkipDeleted();
+}
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include "../include/PostingTable.h"
+#include <algorithm>
+#include <stdexcept>
+
+PostingTable::PostingTable(std::vector<PostingList> postings, std::vector<PositionList> positions, bool with_positions)
+        : size(postings.size()), with_positions(with_positions) {
+    chunks.reserve((size + chunk_size - 1) / chunk_size);
+    for (size_t begin = 0; begin < size; begin += chunk_size) {
+        size_t end = std::min(size, begin + chunk_size);
+        auto chunk = std::make_shared<Chunk>();
+        chunk->postings.assign(std::make_move_iterator(postings.begin() + begin),
+                               std::make_move_iterator(postings.begin() + end));
+        if (with_positions) {
+            chunk->positions.assign(std::make_move_iterator(positions.begin() + begin),
+                                    std::make_move_iterator(positions.begin() + end));
+        }
+        chunks.push_back(std::move(chunk));
+    }
+}
+
+PostingTable::PostingTable(const PostingTable& other)
+        : segment(other.segment), size(other.size), with_positions(other.with_positions) {
+    chunks.reserve(other.chunks.size());
+    for (const auto& chunk : other.chunks) {
+        chunks.push_back(std::atomic_load(&chunk));
+    }
+}
+
+PostingTable& PostingTable::operator=(const PostingTable& other) {
+    if (this != &other) {
+        *this = PostingTable(other);
+    }
+    return *this;
+}
+
+PostingTable PostingTable::Attach(const IndexSegment::Reader& reader, size_t term_count) {
+    using namespace IndexSegment;
+
+    // Таблица TermList проверяется только по размеру, остальные секции - при сборке кусков
+    auto source = std::make_shared<Segment>();
+    source->term_count = term_count;
+    source->document_count = reader.GetHeader().document_count;
+    source->lists = reader.SectionArray<TermList>(TermLists, term_count);
+    source->blocks = reinterpret_cast<const PostingBlock*>(reader.SectionData(Blocks));
+    source->block_total = reader.SectionSize(Blocks) / sizeof(PostingBlock);
+    source->words = reinterpret_cast<const uint32_t*>(reader.SectionData(Words));
+    source->word_total = reader.SectionSize(Words) / sizeof(uint32_t);
+    source->position_offsets = reinterpret_cast<const uint64_t*>(reader.SectionData(PositionOffsets));
+    source->group_total = reader.SectionSize(PositionOffsets) / sizeof(uint64_t);
+    source->position_data = reinterpret_cast<const uint8_t*>(reader.SectionData(PositionData));
+    source->position_size = reader.SectionSize(PositionData);
+
+    PostingTable table;
+    table.segment = std::move(source);
+    table.size = term_count;
+    table.with_positions = reader.SectionSize(PositionOffsets) > 0;
+    table.chunks.resize((term_count + chunk_size - 1) / chunk_size);
+    return table;
+}
+
+uint32_t PostingTable::Add() {
+    if (size % chunk_size == 0) {
+        chunks.push_back(std::make_shared<Chunk>());
+    }
+
+    Chunk& chunk = MutableChunk(chunks.size() - 1);
+    chunk.postings.emplace_back();
+    if (with_positions) {
+        chunk.positions.emplace_back();
+    }
+    return static_cast<uint32_t>(size++);
+}
+
+const PostingTable::Chunk& PostingTable::GetChunk(size_t index) const {
+    std::shared_ptr<Chunk> chunk = std::atomic_load(&chunks[index]);
+    if (!chunk) {
+        // Кусок могут одновременно собирать несколько читателей: остаётся собранный первым
+        std::shared_ptr<Chunk> built = BuildChunk(index);
+        if (std::atomic_compare_exchange_strong(&chunks[index], &chunk, built)) {
+            chunk = std::move(built);
+        }
+    }
+
+    // Собранный кусок больше не заменяется, пока жива таблица, поэтому ссылка остаётся действительной
+    return *chunk;
+}
+
+PostingTable::Chunk& PostingTable::MutableChunk(size_t index) {
+    std::shared_ptr<Chunk>& chunk = chunks[index];
+    if (!chunk) {
+        chunk = BuildChunk(index);
+    } else if (chunk.use_count() > 1) {
+        // Списки копии разделяют данные со списками оригинала до первого изменения
+        chunk = std::make_shared<Chunk>(*chunk);
+    }
+
+    return *chunk;
+}
+
+std::shared_ptr<const PostingTable::Chunk> PostingTable::ReadChunk(size_t index) const {
+    std::shared_ptr<Chunk> chunk = std::atomic_load(&chunks[index]);
+    return chunk ? chunk : BuildChunk(index);
+}
+
+std::shared_ptr<PostingTable::Chunk> PostingTable::BuildChunk(size_t index) const {
+    const Segment& source = *segment;
+    size_t begin = index * chunk_size;
+    size_t end = std::min(source.term_count, begin + chunk_size);
+
+    auto chunk = std::make_shared<Chunk>();
+    chunk->postings.reserve(end - begin);
+    for (size_t id = begin; id < end; ++id) {
+        const IndexSegment::TermList& list = source.lists[id];
+        if (list.first_block > source.block_total || list.block_count > source.block_total - list.first_block
+            || list.first_word > source.word_total || list.word_count > source.word_total - list.first_word) {
+            throw std::runtime_error("index segment postings are malformed");
+        }
+
+        chunk->postings.push_back(PostingList::Attach(source.blocks + list.first_block, list.block_count,
+                                                      source.words + list.first_word, list.word_count,
+                                                      list.size, list.max_count));
+
+        // Заголовки блоков и doc_id из сегмента дальше используются без проверок: как
+        // размеры буферов распаковки и номера в таблицах документов
+        if (!chunk->postings.back().IsWellFormed(source.document_count)) {
+            throw std::runtime_error("index segment postings are malformed");
+        }
+    }
+
+    if (!with_positions) {
+        return chunk;
+    }
+
+    // Позиции терминов лежат подряд в порядке идентификаторов: данные термина кончаются
+    // там, где начинается первая группа следующего
+    chunk->positions.reserve(end - begin);
+    for (size_t id = begin; id < end; ++id) {
+        const IndexSegment::TermList& list = source.lists[id];
+        size_t group_count = PositionList::GroupsFor(list.size);
+        uint64_t next_group = id + 1 < source.term_count ? source.lists[id + 1].first_group : source.group_total;
+        if (list.first_group > source.group_total || group_count > source.group_total - list.first_group
+            || next_group > source.group_total || next_group < list.first_group + group_count) {
+            throw std::runtime_error("index segment positions are malformed");
+        }
+
+        const uint64_t* offsets = source.position_offsets + list.first_group;
+        uint64_t data_end = next_group < source.group_total ? source.position_offsets[next_group] : source.position_size;
+        if (data_end > source.position_size
+            || (group_count > 0 && (offsets[group_count - 1] > data_end || offsets[0] > offsets[group_count - 1]))) {
+            throw std::runtime_error("index segment positions are malformed");
+        }
+
+        chunk->positions.push_back(PositionList::Attach(offsets, group_count, source.position_data, data_end, list.size));
+    }
+
+    return chunk;
+}
\ No newline at end of file
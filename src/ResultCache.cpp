@@ -0,0 +1,54 @@
+#include "../include/ResultCache.h"
+#include <algorithm>
+
+namespace {
+    // Нечётные множители для независимых хешей строк эскиза
+    const uint64_t row_seeds[] = {
+        0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull, 0xD6E8FEB86659FD93ull
+    };
+}
+
+FrequencySketch::FrequencySketch(size_t width) {
+    uint32_t bits = 6;
+    while ((size_t(1) << bits) < width && bits < 24) {
+        ++bits;
+    }
+
+    counters.assign(rows << bits, 0);
+    index_shift = 64 - bits;
+    sample_size = 10 << bits;
+}
+
+size_t FrequencySketch::Index(uint64_t hash, size_t row) const {
+    size_t width = counters.size() / rows;
+    return row * width + static_cast<size_t>(((hash ^ (hash >> 29)) * row_seeds[row]) >> index_shift);
+}
+
+void FrequencySketch::Increment(uint64_t hash) {
+    for (size_t row = 0; row < rows; ++row) {
+        uint8_t& counter = counters[Index(hash, row)];
+        if (counter < max_count) {
+            ++counter;
+        }
+    }
+
+    if (++additions >= sample_size) {
+        Age();
+    }
+}
+
+uint32_t FrequencySketch::Estimate(uint64_t hash) const {
+    uint32_t estimate = max_count;
+    for (size_t row = 0; row < rows; ++row) {
+        estimate = std::min<uint32_t>(estimate, counters[Index(hash, row)]);
+    }
+
+    return estimate;
+}
+
+void FrequencySketch::Age() {
+    for (auto& counter : counters) {
+        counter >>= 1;
+    }
+    additions /= 2;
+}
\ No newline at end of file
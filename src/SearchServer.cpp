@@ -1,113 +1,811 @@
 #include "SearchServer.h"
-#include <sstream>
+#include "Intersection.h"
+#include "PhraseQuery.h"
+#include "Ranking.h"
+#include "TermCursor.h"
 #include <algorithm>
-#include <set>
+#include <atomic>
 #include <cmath>
+#include <tuple>
 
-std::vector<std::string> SearchServer::SplitIntoWords(const std::string& text) {
-    std::vector<std::string> words;
-    std::istringstream iss(text);
-    std::string word;
+namespace {
+    using ScoredDocument = std::pair<size_t, float>;
+}
+
+// Буферы одного обработчика запросов: переиспользуются от запроса к запросу,
+// поэтому после первых запросов на разбор и оценку память не выделяется -
+// только на сам список результатов
+struct QueryScratch {
+    Tokenizer tokenizer;
+    ParsedQuery query;
+    std::vector<std::string_view> words;
+    QueryPlan plan;
+    std::vector<double> probabilities;
+    std::string cacheKey;
+    std::vector<PostingsView> wordEntries;
+    std::vector<uint32_t> candidates;
+    std::vector<float> relevance;
+    std::vector<uint32_t> matches;
+    std::vector<uint64_t> touched;
+    std::vector<uint32_t> order;
+    std::tuple<std::vector<TermCursor<SumRanking>>, std::vector<TermCursor<Bm25Ranking>>> cursors;
+    std::vector<ScoredDocument> top;
+
+    // Проверка фраз и NEAR: для каждого слова условий - номер его курсора, позиции
+    // и буфер под позиции текущего документа. Пустой slots - позиции не проверяются.
+    std::vector<uint32_t> slots;
+    std::vector<const PositionList*> positionLists;
+    std::vector<PositionList::ReadPosition> readPositions;
+    std::vector<std::vector<uint32_t>> positions;
+    std::vector<const std::vector<uint32_t>*> phrase;
 
-    while (iss >> word) {
-        std::transform(word.begin(), word.end(), word.begin(),
-                       [](unsigned char c) { return std::tolower(c); });
-        words.push_back(word);
+
+    // Курсоры слов запроса, упорядоченные по длине списков
+    template <typename Ranking>
+    std::vector<TermCursor<Ranking>>& Cursors(const Ranking& ranking) {
+        auto& termCursors = std::get<std::vector<TermCursor<Ranking>>>(cursors);
+        termCursors.clear();
+        for (const auto& entries : wordEntries) {
+            termCursors.emplace_back(entries, ranking);
+        }
+        return termCursors;
     }
+};
 
-    return words;
-}
+namespace {
+    // Число запросов, которое обработчик пакета забирает за раз
+    const size_t queries_per_take = 8;
 
-std::vector<RelativeIndex> SearchServer::ProcessQuery(const std::string& query) {
-    auto queryWords = SplitIntoWords(query);
+    // Диапазон номеров документов, который объединение списков накапливает за раз
+    const size_t union_chunk_docs = 1 << 14;
 
-    std::set<std::string> uniqueWords(queryWords.begin(), queryWords.end());
+    // Стоимость операций пересечения в наносекундах (подобрано по замерам на 200 000
+    // документов с распределением слов по Ципфу, запросы из 2-3 слов разной частоты)
+    const double lead_cost = 6.0;            // кандидат из самого короткого списка
+    const double merge_step_cost = 20.0;     // кандидат при слиянии с очередным списком
+    const double merge_posting_cost = 1.2;   // вхождение распакованного блока при слиянии
+    const double gallop_step_cost = 11.5;    // кандидат при галопе, без учёта поиска
+    const double gallop_probe_cost = 10.5;   // шаг экспоненциального поиска
+    const double gallop_posting_cost = 0.75; // вхождение распакованного блока при галопе
+    const double bitmap_posting_cost = 7.6;  // вхождение при накоплении по диапазонам
+    const double bitmap_match_cost = 10.0;   // совпавший документ при накоплении
 
-    std::vector<std::string> sortedUniqueWords(uniqueWords.begin(), uniqueWords.end());
-    std::sort(sortedUniqueWords.begin(), sortedUniqueWords.end(),
-              [this](const std::string& a, const std::string& b) {
-                  return _index.GetWordCount(a).size() < _index.GetWordCount(b).size();
-              });
+    size_t CountTrailingZeros(uint64_t bits) {
+#if defined(__GNUC__)
+        return static_cast<size_t>(__builtin_ctzll(bits));
+#else
+        size_t count = 0;
+        while ((bits & 1) == 0) {
+            bits >>= 1;
+            ++count;
+        }
+        return count;
+#endif
+    }
 
-    if (sortedUniqueWords.empty()) {
-        return {};
+    // Буферы живут в потоке и переходят от пакета к пакету. Обработчик не вызывает
+    // других задач пула, поэтому поток одновременно выполняет не больше одного запроса.
+    QueryScratch& ThreadScratch() {
+        thread_local QueryScratch scratch;
+        return scratch;
     }
 
-    auto rarestWordEntries = _index.GetWordCount(sortedUniqueWords[0]);
+    // Лучшие limit документов (0 - все) в куче, на вершине которой худший из отобранных
+    class TopDocuments {
+    public:
+        TopDocuments(size_t limit, bool ordered_ids, std::vector<ScoredDocument>& documents)
+                : limit(limit), ordered_ids(ordered_ids), documents(documents) {
+            documents.clear();
+        }
 
-    if (rarestWordEntries.empty()) {
-        return {};
+
+        void Push(size_t doc_id, float rank) {
+            ScoredDocument candidate(doc_id, rank);
+            if (limit == 0 || documents.size() < limit) {
+                documents.push_back(candidate);
+                std::push_heap(documents.begin(), documents.end(), Better);
+            } else if (Better(candidate, documents.front())) {
+                std::pop_heap(documents.begin(), documents.end(), Better);
+                documents.back() = candidate;
+                std::push_heap(documents.begin(), documents.end(), Better);
+            }
+        }
+
+
+        // Может ли документ с релевантностью не выше bound, ещё не просмотренный, попасть в отбор.
+        // При равной релевантности решает doc_id: если документы обходятся по возрастанию
+        // doc_id, следующий документ всегда проигрывает уже отобранным.
+        bool CanEnter(float bound) const {
+            if (limit == 0 || documents.size() < limit) {
+                return true;
+            }
+            float threshold = documents.front().second;
+            return bound > threshold || (bound == threshold && !ordered_ids);
+        }
+
+
+        // Отобранные документы по убыванию релевантности
+        const std::vector<ScoredDocument>& Sorted() {
+            std::sort_heap(documents.begin(), documents.end(), Better);
+            return documents;
+        }
+
+    private:
+        size_t limit;
+        bool ordered_ids;
+        std::vector<ScoredDocument>& documents;
+
+
+        static bool Better(const ScoredDocument& a, const ScoredDocument& b) {
+            return a.second > b.second || (a.second == b.second && a.first < b.first);
+        }
+    };
+
+    // Оставляет среди кандидатов (внутренние номера по возрастанию) только документы списка
+    // и прибавляет к их релевантности частоты. Блоки, в диапазон которых не попадает
+    // ни один кандидат, пропускаются по заголовкам без распаковки.
+    using IntersectionKernel = size_t (*)(const uint32_t*, size_t, const uint32_t*, size_t, uint32_t*, uint32_t*);
+
+    template <typename Ranking>
+    void IntersectCandidates(const PostingList& list, const Ranking& ranking, IntersectionKernel kernel,
+                             std::vector<uint32_t>& candidates, std::vector<float>& relevance) {
+        uint32_t docIds[PostingList::block_size];
+        uint32_t counts[PostingList::block_size];
+        uint32_t candidatePositions[PostingList::block_size];
+        uint32_t blockPositions[PostingList::block_size];
+
+        BlockBounds bounds{list.BlockData(), list.BlockCount()};
+        auto term = ranking.Prepare(list);
+        size_t kept = 0, next = 0;
+
+        while (next < candidates.size() && bounds.AdvanceTo(candidates[next])) {
+            size_t block = bounds.current;
+            size_t end = std::upper_bound(candidates.begin() + next, candidates.end(), bounds.blocks[block].last_doc)
+                         - candidates.begin();
+            size_t length = list.DecodeBlock(block, docIds, counts);
+            size_t found = kernel(candidates.data() + next, end - next, docIds, length,
+                                  candidatePositions, blockPositions);
+
+            // Совпадения идут по возрастанию, поэтому кандидаты уплотняются на месте
+            for (size_t k = 0; k < found; ++k) {
+                size_t from = next + candidatePositions[k];
+                candidates[kept] = candidates[from];
+                relevance[kept] = relevance[from] + ranking.Score(term, candidates[from], counts[blockPositions[k]]);
+                ++kept;
+            }
+
+            next = end;
+            ++bounds.current;
+        }
+
+        candidates.resize(kept);
+        relevance.resize(kept);
+    }
+
+    // Проверяет фразы и NEAR запроса на документе, на котором стоят курсоры слов условий.
+    // Позиции читаются только здесь, для документов, уже прошедших пересечение списков.
+    template <typename Ranking>
+    bool MatchesPositions(QueryScratch& scratch, const std::vector<TermCursor<Ranking>>& cursors) {
+        for (const PositionConstraint& constraint : scratch.query.Constraints()) {
+            for (size_t i = 0; i < constraint.length; ++i) {
+                size_t word = constraint.first + i;
+                const PostingCursor& postings = cursors[scratch.slots[word]].Postings();
+                scratch.positionLists[word]->Read(postings.BlockIndex(), postings.BlockPosition(),
+                                                  postings.BlockCounts(), scratch.positions[word],
+                                                  scratch.readPositions[word]);
+                scratch.phrase[i] = &scratch.positions[word];
+            }
+
+            bool matched = constraint.distance == 0
+                           ? MatchPhrase(scratch.phrase.data(), constraint.length)
+                           : MatchNear(*scratch.phrase[0], *scratch.phrase[1], constraint.distance);
+            if (!matched) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Пересечение списков целиком: кандидаты - документы самого короткого списка, каждый
+    // следующий список оставляет из них только свои документы. Ядро пересечения блоков
+    // (слияние или галоп) выбрано планом запроса.
+    template <typename Ranking>
+    void EvaluateExhaustive(const IndexSnapshot& snapshot, const Ranking& ranking, IntersectionMethod method,
+                            QueryScratch& scratch, TopDocuments& top) {
+        const auto& wordEntries = scratch.wordEntries;
+        auto& candidates = scratch.candidates;
+        auto& relevance = scratch.relevance;
+        candidates.clear();
+        relevance.clear();
+
+        auto leadTerm = ranking.Prepare(*wordEntries[0].List());
+        for (auto cursor = wordEntries[0].Cursor(); !cursor.AtEnd(); cursor.Next()) {
+            candidates.push_back(cursor.DocId());
+            relevance.push_back(ranking.Score(leadTerm, cursor.DocId(), cursor.Count()));
+        }
+
+        IntersectionKernel kernel = method == IntersectionMethod::Gallop ? Intersection::Gallop : Intersection::Simd;
+        for (size_t i = 1; i < wordEntries.size() && !candidates.empty(); ++i) {
+            IntersectCandidates(*wordEntries[i].List(), ranking, kernel, candidates, relevance);
+        }
+
+        if (scratch.slots.empty()) {
+            for (size_t i = 0; i < candidates.size(); ++i) {
+                top.Push(snapshot.ExternalId(candidates[i]), relevance[i]);
+            }
+            return;
+        }
+
+        // Позиции есть только у курсоров, поэтому курсоры слов условий проходят по кандидатам
+        auto& cursors = scratch.Cursors(ranking);
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            if (!top.CanEnter(relevance[i])) {
+                continue;
+            }
+            for (uint32_t slot : scratch.slots) {
+                cursors[slot].AdvanceTo(candidates[i]);
+            }
+            if (MatchesPositions(scratch, cursors)) {
+                top.Push(snapshot.ExternalId(candidates[i]), relevance[i]);
+            }
+        }
+    }
+
+    // Выравнивает курсоры на ближайшем документе >= курсора cursors[0], который есть во всех
+    // списках. Возвращает false, если общих документов больше нет.
+    template <typename Ranking>
+    bool AlignCursors(std::vector<TermCursor<Ranking>>& cursors) {
+        TermCursor<Ranking>& lead = cursors[0];
+        for (size_t i = 1; i < cursors.size();) {
+            if (lead.AtEnd()) {
+                return false;
+            }
+            cursors[i].AdvanceTo(lead.DocId());
+            if (cursors[i].AtEnd()) {
+                return false;
+            }
+            if (cursors[i].DocId() != lead.DocId()) {
+                lead.AdvanceTo(cursors[i].DocId());
+                i = 1;
+                continue;
+            }
+            ++i;
+        }
+        return !lead.AtEnd();
+    }
+
+    // Документ за документом по курсорам всех слов (все слова обязательны): курсор
+    // самого короткого списка ведёт, остальные догоняют его через AdvanceTo, и каждый общий
+    // документ оценивается сразу, без промежуточных массивов релевантности
+    template <typename Ranking>
+    void EvaluateDaat(const IndexSnapshot& snapshot, const Ranking& ranking, QueryScratch& scratch,
+                      TopDocuments& top) {
+        auto& cursors = scratch.Cursors(ranking);
+
+        while (AlignCursors(cursors)) {
+            float relevance = 0.0f;
+            for (const auto& cursor : cursors) {
+                relevance += cursor.Score();
+            }
+            if (scratch.slots.empty() || (top.CanEnter(relevance) && MatchesPositions(scratch, cursors))) {
+                top.Push(snapshot.ExternalId(cursors[0].DocId()), relevance);
+            }
+            cursors[0].Next();
+        }
+    }
+
+    // То же с отсечением Block-Max WAND. Пока отбор не заполнен, оценивается каждый общий
+    // документ; затем перед выравниванием курсоров сумма верхних границ по наибольшим
+    // частотам блоков, содержащих документ, сравнивается с порогом, и если документ не может
+    // войти в отбор, пропускается весь диапазон до конца ближайшего из этих блоков -
+    // без распаковки блоков остальных списков.
+    template <typename Ranking>
+    void EvaluateBlockMax(const IndexSnapshot& snapshot, const Ranking& ranking, QueryScratch& scratch,
+                          TopDocuments& top) {
+        auto& cursors = scratch.Cursors(ranking);
+        float maxTotal = 0.0f;
+        for (const auto& cursor : cursors) {
+            maxTotal += cursor.MaxScore();
+        }
+
+        TermCursor<Ranking>& lead = cursors[0];
+        while (!lead.AtEnd()) {
+            // Даже документ с наибольшими частотами всех слов уже не войдёт в отбор
+            if (!top.CanEnter(maxTotal)) {
+                return;
+            }
+
+            uint32_t docId = lead.DocId();
+
+            float bound = 0.0f;
+            uint32_t boundaryDoc = UINT32_MAX;
+            for (auto& cursor : cursors) {
+                if (!cursor.ShallowAdvance(docId)) {
+                    return;
+                }
+                bound += cursor.BlockMaxScore();
+                boundaryDoc = std::min(boundaryDoc, cursor.BlockLastDoc());
+            }
+
+            if (!top.CanEnter(bound)) {
+                if (boundaryDoc == UINT32_MAX) {
+                    return;
+                }
+                lead.AdvanceTo(boundaryDoc + 1);
+                continue;
+            }
+
+            float relevance = lead.Score();
+            bool matched = true;
+            for (size_t i = 1; i < cursors.size(); ++i) {
+                cursors[i].AdvanceTo(docId);
+                if (cursors[i].AtEnd()) {
+                    return;
+                }
+                if (cursors[i].DocId() != docId) {
+                    lead.AdvanceTo(cursors[i].DocId());
+                    matched = false;
+                    break;
+                }
+                relevance += cursors[i].Score();
+            }
+
+            if (matched) {
+                if (scratch.slots.empty() || (top.CanEnter(relevance) && MatchesPositions(scratch, cursors))) {
+                    top.Push(snapshot.ExternalId(docId), relevance);
+                }
+                lead.Next();
+            }
+        }
+    }
+
+    // Объединение списков (документ должен содержать не меньше minimum слов) накоплением
+    // по диапазонам из union_chunk_docs номеров: каждое слово прибавляет оценки своих
+    // вхождений диапазона в плоские массивы, битовая карта отмечает затронутые документы,
+    // и по ней отбираются документы с достаточным числом слов
+    template <typename Ranking>
+    void EvaluateUnionChunked(const IndexSnapshot& snapshot, const Ranking& ranking, size_t minimum,
+                              QueryScratch& scratch, TopDocuments& top) {
+        auto& cursors = scratch.Cursors(ranking);
+        auto& relevance = scratch.relevance;
+        auto& matches = scratch.matches;
+        auto& touched = scratch.touched;
+        relevance.assign(union_chunk_docs, 0.0f);
+        matches.assign(union_chunk_docs, 0);
+        touched.assign(union_chunk_docs / 64, 0);
+
+        while (true) {
+            // Диапазон начинается с ближайшего документа, пустые промежутки пропускаются
+            uint32_t base = UINT32_MAX;
+            for (const auto& cursor : cursors) {
+                if (!cursor.AtEnd()) {
+                    base = std::min(base, cursor.DocId());
+                }
+            }
+            if (base == UINT32_MAX) {
+                return;
+            }
+
+            uint64_t end = static_cast<uint64_t>(base) + union_chunk_docs;
+            for (auto& cursor : cursors) {
+                for (; !cursor.AtEnd() && cursor.DocId() < end; cursor.Next()) {
+                    size_t slot = cursor.DocId() - base;
+                    relevance[slot] += cursor.Score();
+                    ++matches[slot];
+                    touched[slot >> 6] |= 1ull << (slot & 63);
+                }
+            }
+
+            for (size_t word = 0; word < touched.size(); ++word) {
+                for (uint64_t bits = touched[word]; bits != 0; bits &= bits - 1) {
+                    size_t slot = word * 64 + CountTrailingZeros(bits);
+                    if (matches[slot] >= minimum) {
+                        top.Push(snapshot.ExternalId(base + static_cast<uint32_t>(slot)), relevance[slot]);
+                    }
+                    relevance[slot] = 0.0f;
+                    matches[slot] = 0;
+                }
+                touched[word] = 0;
+            }
+        }
+    }
+
+    // Объединение списков документ за документом: следующий документ - наименьший среди
+    // курсоров. С отсечением (prune) работает как MaxScore: слова упорядочиваются по верхней
+    // границе оценки, и самые "дешёвые" из них, сумма границ которых не проходит порог отбора,
+    // становятся необязательными - документы, содержащие только их, не рассматриваются,
+    // а их курсоры лишь догоняют документы остальных слов через AdvanceTo.
+    template <typename Ranking>
+    void EvaluateUnion(const IndexSnapshot& snapshot, const Ranking& ranking, size_t minimum, bool prune,
+                       QueryScratch& scratch, TopDocuments& top) {
+        auto& cursors = scratch.Cursors(ranking);
+        auto& order = scratch.order;
+        order.resize(cursors.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = static_cast<uint32_t>(i);
+        }
+        std::sort(order.begin(), order.end(),
+                  [&cursors](uint32_t a, uint32_t b) { return cursors[a].MaxScore() < cursors[b].MaxScore(); });
+
+        size_t essential = 0; // order[0..essential) - необязательные слова
+        float optionalBound = 0.0f;
+        while (true) {
+            while (prune && essential < order.size()
+                   && !top.CanEnter(optionalBound + cursors[order[essential]].MaxScore())) {
+                optionalBound += cursors[order[essential]].MaxScore();
+                ++essential;
+            }
+
+            uint32_t docId = UINT32_MAX;
+            for (size_t k = essential; k < order.size(); ++k) {
+                const auto& cursor = cursors[order[k]];
+                if (!cursor.AtEnd()) {
+                    docId = std::min(docId, cursor.DocId());
+                }
+            }
+            if (docId == UINT32_MAX) {
+                return;
+            }
+
+            float bound = optionalBound;
+            size_t matched = 0;
+            for (size_t k = essential; k < order.size(); ++k) {
+                const auto& cursor = cursors[order[k]];
+                if (!cursor.AtEnd() && cursor.DocId() == docId) {
+                    bound += cursor.Score();
+                    ++matched;
+                }
+            }
+
+            if (matched + essential >= minimum && top.CanEnter(bound)) {
+                for (size_t k = 0; k < essential; ++k) {
+                    auto& cursor = cursors[order[k]];
+                    cursor.AdvanceTo(docId);
+                    if (!cursor.AtEnd() && cursor.DocId() == docId) {
+                        ++matched;
+                    }
+                }
+
+                // Оценки складываются в порядке слов запроса, как и при накоплении по диапазонам
+                if (matched >= minimum) {
+                    float relevance = 0.0f;
+                    for (const auto& cursor : cursors) {
+                        if (!cursor.AtEnd() && cursor.DocId() == docId) {
+                            relevance += cursor.Score();
+                        }
+                    }
+                    top.Push(snapshot.ExternalId(docId), relevance);
+                }
+            }
+
+            for (size_t k = essential; k < order.size(); ++k) {
+                auto& cursor = cursors[order[k]];
+                if (!cursor.AtEnd() && cursor.DocId() == docId) {
+                    cursor.Next();
+                }
+            }
+        }
+    }
+
+    // Выполняет план запроса. Если нужны все слова, объединение сводится к пересечению;
+    // в режиме exhaustive план выбирает между пересечением кандидатов и накоплением
+    // по диапазонам номеров (оно же вычисляет объединение).
+    template <typename Ranking>
+    void Evaluate(const QueryPlan& plan, const IndexSnapshot& snapshot, QueryScratch& scratch, TopDocuments& top) {
+        Ranking ranking(snapshot);
+        bool conjunctive = plan.minimum == plan.terms.size();
+        if (plan.strategy == EvaluationStrategy::Exhaustive) {
+            if (plan.method == IntersectionMethod::Bitmap) {
+                EvaluateUnionChunked(snapshot, ranking, plan.minimum, scratch, top);
+            } else {
+                EvaluateExhaustive(snapshot, ranking, plan.method, scratch, top);
+            }
+        } else if (!conjunctive) {
+            EvaluateUnion(snapshot, ranking, plan.minimum, plan.strategy == EvaluationStrategy::BlockMax, scratch, top);
+        } else if (plan.strategy == EvaluationStrategy::BlockMax) {
+            EvaluateBlockMax(snapshot, ranking, scratch, top);
+        } else {
+            EvaluateDaat(snapshot, ranking, scratch, top);
+        }
     }
 
-    std::map<size_t, float> documentAbsRelevance;
+    // Верхние границы оценки слов плана при ранжировании Ranking
+    template <typename Ranking>
+    void SetMaxScores(const IndexSnapshot& snapshot, const std::vector<PostingsView>& wordEntries, QueryPlan& plan) {
+        Ranking ranking(snapshot);
+        for (size_t i = 0; i < plan.terms.size(); ++i) {
+            PlannedTerm& term = plan.terms[i];
+            term.max_score = ranking.Bound(ranking.Prepare(*wordEntries[i].List()), term.max_count);
+        }
+    }
+
+    // Вероятность того, что документ содержит не меньше minimum слов плана, если слова
+    // встречаются независимо: доля документов слова - его вероятность
+    double MatchProbability(const QueryPlan& plan, double documents, std::vector<double>& exactly) {
+        // exactly[k] - вероятность встретить ровно k из уже учтённых слов
+        exactly.assign(plan.terms.size() + 1, 0.0);
+        exactly[0] = 1.0;
+        for (size_t i = 0; i < plan.terms.size(); ++i) {
+            double p = std::min(1.0, plan.terms[i].document_frequency / documents);
+            for (size_t k = i + 1; k > 0; --k) {
+                exactly[k] = exactly[k] * (1 - p) + exactly[k - 1] * p;
+            }
+            exactly[0] *= 1 - p;
+        }
+
+        double probability = 0.0;
+        for (size_t k = plan.minimum; k < exactly.size(); ++k) {
+            probability += exactly[k];
+        }
+        return probability;
+    }
+
+    // Оценивает время способов пересечения и выбирает самый быстрый. Блоки, в которые
+    // не попал ни один кандидат, пропускаются по заголовкам, поэтому для следующего
+    // списка учитываются только вхождения блоков около ожидаемых кандидатов.
+    void ChooseIntersection(double documents, IntersectionMethod forced, QueryPlan& plan) {
+        const auto& terms = plan.terms;
+        double candidates = static_cast<double>(terms[0].document_frequency);
+        double merge = candidates * lead_cost;
+        double gallop = merge;
+        double bitmap = plan.estimated_matches * bitmap_match_cost;
+        for (const PlannedTerm& term : terms) {
+            bitmap += term.document_frequency * bitmap_posting_cost;
+        }
+
+        for (size_t i = 1; i < terms.size(); ++i) {
+            auto length = static_cast<double>(terms[i].document_frequency);
+            double touched = std::min(length, candidates * PostingList::block_size);
+            double probes = std::log2(2.0 + touched / std::max(candidates, 1.0));
+            merge += candidates * merge_step_cost + touched * merge_posting_cost;
+            gallop += candidates * (gallop_step_cost + gallop_probe_cost * probes) + touched * gallop_posting_cost;
+            candidates *= length / documents;
+        }
+
+        // Объединение вычисляется только накоплением; позиции читаются через курсоры кандидатов
+        IntersectionMethod method = forced;
+        if (plan.minimum < terms.size()) {
+            method = IntersectionMethod::Bitmap;
+        } else if (method == IntersectionMethod::Auto || (method == IntersectionMethod::Bitmap && plan.positional)) {
+            method = gallop < merge ? IntersectionMethod::Gallop : IntersectionMethod::Merge;
+            if (!plan.positional && forced == IntersectionMethod::Auto && bitmap < std::min(merge, gallop)) {
+                method = IntersectionMethod::Bitmap;
+            }
+        }
 
-    for (const auto& entry : rarestWordEntries) {
-        documentAbsRelevance[entry.doc_id] = entry.count;
+        plan.method = method;
+        plan.estimated_cost = method == IntersectionMethod::Bitmap ? bitmap
+                              : method == IntersectionMethod::Gallop ? gallop : merge;
     }
+}
+
+void SearchServer::ParseQuery(const std::string& query, QueryScratch& scratch) const {
+    scratch.query.Parse(query, scratch.tokenizer);
+    const auto& queryWords = scratch.query.Words();
+
+    auto& uniqueWords = scratch.words;
+    uniqueWords.assign(queryWords.begin(), queryWords.end());
+    std::sort(uniqueWords.begin(), uniqueWords.end());
+    uniqueWords.erase(std::unique(uniqueWords.begin(), uniqueWords.end()), uniqueWords.end());
+}
+
+void SearchServer::PlanQuery(const IndexSnapshot& snapshot, QueryScratch& scratch) const {
+    const auto& uniqueWords = scratch.words;
+    QueryPlan& plan = scratch.plan;
+    plan.terms.clear();
+    plan.missing.clear();
+    plan.minimum = 0;
+    plan.empty = false;
+    plan.strategy = _strategy;
+    plan.method = IntersectionMethod::Merge;
+    plan.estimated_matches = 0;
+    plan.estimated_cost = 0;
+    scratch.wordEntries.clear();
+    scratch.slots.clear();
 
-    for (size_t i = 1; i < sortedUniqueWords.size(); ++i) {
-        auto wordEntries = _index.GetWordCount(sortedUniqueWords[i]);
+    // Фразы и NEAR проверяются по позициям, если они есть в индексе; все слова такого
+    // запроса обязательны. Без позиций условия не проверяются - остаются просто слова.
+    plan.positional = !scratch.query.Constraints().empty() && snapshot.HasPositions();
+    bool requireAll = _match == MatchMode::All || plan.positional;
 
-        if (wordEntries.empty()) {
+    // Каждое слово ищется в словаре один раз. Если нужны все слова, первое же слово
+    // без вхождений делает результат пустым, и остальные слова уже не ищутся.
+    for (size_t i = 0; i < uniqueWords.size(); ++i) {
+        uint32_t termId = snapshot.FindTerm(uniqueWords[i]);
+        const PostingList* list = snapshot.GetPostings(termId).List();
+        if (!list || list->Empty()) {
+            plan.missing.push_back(static_cast<uint32_t>(i));
+            if (requireAll) {
+                plan.empty = true;
+                return;
+            }
             continue;
         }
 
-        std::map<size_t, float> updatedRelevance;
+        plan.terms.push_back({static_cast<uint32_t>(i), termId, list->Size(), list->MaxCount(), 0.0f});
+    }
 
-        for (const auto& entry : wordEntries) {
-            if (documentAbsRelevance.count(entry.doc_id) > 0) {
-                updatedRelevance[entry.doc_id] = documentAbsRelevance[entry.doc_id] + entry.count;
+    // Сколько слов должен содержать документ. Слова без вхождений не мешают режимам
+    // any и at_least, но могут сделать требование невыполнимым.
+    if (requireAll) {
+        plan.minimum = plan.terms.size();
+    } else {
+        plan.minimum = _match == MatchMode::Any ? 1 : std::min(std::max<size_t>(_minimum_match, 1), uniqueWords.size());
+    }
+    if (plan.terms.empty() || plan.terms.size() < plan.minimum) {
+        plan.empty = true;
+        return;
+    }
+
+    // Списки обходятся начиная с самого короткого: кандидатов становится только меньше
+    std::sort(plan.terms.begin(), plan.terms.end(), [](const PlannedTerm& a, const PlannedTerm& b) {
+        return a.document_frequency < b.document_frequency
+               || (a.document_frequency == b.document_frequency && a.word < b.word);
+    });
+    for (const PlannedTerm& term : plan.terms) {
+        scratch.wordEntries.push_back(snapshot.GetPostings(term.term_id));
+    }
+
+    if (_ranking == RankingModel::Bm25) {
+        SetMaxScores<Bm25Ranking>(snapshot, scratch.wordEntries, plan);
+    } else {
+        SetMaxScores<SumRanking>(snapshot, scratch.wordEntries, plan);
+    }
+
+    auto documents = static_cast<double>(std::max<size_t>(snapshot.GetDocumentCount(), 1));
+    plan.estimated_matches = documents * MatchProbability(plan, documents, scratch.probabilities);
+    ChooseIntersection(documents, _intersection, plan);
+
+    if (plan.positional) {
+        const auto& constraintWords = scratch.query.ConstraintWords();
+        scratch.positionLists.clear();
+        scratch.readPositions.assign(constraintWords.size(), PositionList::ReadPosition());
+        scratch.positions.resize(std::max(scratch.positions.size(), constraintWords.size()));
+        scratch.phrase.resize(constraintWords.size());
+        for (std::string_view word : constraintWords) {
+            auto unique = static_cast<uint32_t>(std::lower_bound(uniqueWords.begin(), uniqueWords.end(), word)
+                                                - uniqueWords.begin());
+            auto slot = std::find_if(plan.terms.begin(), plan.terms.end(),
+                                     [unique](const PlannedTerm& term) { return term.word == unique; });
+            scratch.slots.push_back(static_cast<uint32_t>(slot - plan.terms.begin()));
+            scratch.positionLists.push_back(snapshot.GetPositions(slot->term_id));
+        }
+    }
+}
+
+QueryExplanation SearchServer::Explain(const std::string& query) const {
+    auto snapshot = _index.Snapshot();
+    QueryScratch& scratch = ThreadScratch();
+    ParseQuery(query, scratch);
+    PlanQuery(*snapshot, scratch);
+
+    QueryExplanation explanation;
+    explanation.words.assign(scratch.words.begin(), scratch.words.end());
+    const auto& constraintWords = scratch.query.ConstraintWords();
+    for (const PositionConstraint& constraint : scratch.query.Constraints()) {
+        std::string text;
+        for (size_t i = 0; i < constraint.length; ++i) {
+            if (i > 0) {
+                text += constraint.distance == 0 ? " " : " NEAR/" + std::to_string(constraint.distance) + " ";
             }
+            text.append(constraintWords[constraint.first + i]);
         }
+        explanation.constraints.push_back(constraint.distance == 0 ? '"' + text + '"' : text);
+    }
+    explanation.plan = scratch.plan;
+    return explanation;
+}
+
+std::vector<RelativeIndex> SearchServer::ProcessQuery(const IndexSnapshot& snapshot, const std::string& query,
+                                                      size_t limit, QueryScratch& scratch) const {
+    ParseQuery(query, scratch);
 
-        documentAbsRelevance = std::move(updatedRelevance);
+    if (!_cache) {
+        return RankDocuments(snapshot, limit, scratch);
+    }
 
-        if (documentAbsRelevance.empty()) {
-            return {};
+    // Запросы, отличающиеся только порядком и повтором слов, дают один ключ
+    auto& key = scratch.cacheKey;
+    key.clear();
+    for (std::string_view word : scratch.words) {
+        key.append(word).push_back(' ');
+    }
+    key.append(std::to_string(limit)).push_back(_ranking == RankingModel::Bm25 ? 'b' : 's');
+    if (_match != MatchMode::All) {
+        key.push_back('|');
+        key.append(_match == MatchMode::Any ? "1" : std::to_string(_minimum_match));
+    }
+    const auto& constraintWords = scratch.query.ConstraintWords();
+    for (const PositionConstraint& constraint : scratch.query.Constraints()) {
+        key.push_back(constraint.distance == 0 ? '"' : '~');
+        key.append(std::to_string(constraint.distance));
+        for (size_t i = 0; i < constraint.length; ++i) {
+            key.push_back(' ');
+            key.append(constraintWords[constraint.first + i]);
         }
     }
 
-    std::vector<std::pair<size_t, float>> relevanceVec(documentAbsRelevance.begin(), documentAbsRelevance.end());
+    std::vector<RelativeIndex> result;
+    if (_cache->Find(key, snapshot.Generation(), result)) {
+        return result;
+    }
 
-    if (relevanceVec.empty()) {
+    result = RankDocuments(snapshot, limit, scratch);
+    _cache->Insert(key, snapshot.Generation(), result, result.capacity() * sizeof(RelativeIndex));
+    return result;
+}
+
+std::vector<RelativeIndex> SearchServer::RankDocuments(const IndexSnapshot& snapshot, size_t limit,
+                                                       QueryScratch& scratch) const {
+    PlanQuery(snapshot, scratch);
+    const QueryPlan& plan = scratch.plan;
+    if (plan.empty) {
         return {};
     }
 
-    float maxAbsRelevance = 0.0f;
-    for (const auto& [doc_id, abs_rank] : relevanceVec) {
-        maxAbsRelevance = std::max(maxAbsRelevance, abs_rank);
+    // Нужны только limit лучших документов: отбираем их кучей за O(n log k), не сортируя все совпадения
+    TopDocuments top(limit, snapshot.IdentityIds(), scratch.top);
+    if (_ranking == RankingModel::Bm25) {
+        Evaluate<Bm25Ranking>(plan, snapshot, scratch, top);
+    } else {
+        Evaluate<SumRanking>(plan, snapshot, scratch, top);
     }
 
-    if (maxAbsRelevance == 0) {
+    // Наибольшая релевантность - у первого из отобранных документов
+    const auto& topDocuments = top.Sorted();
+    if (topDocuments.empty() || topDocuments[0].second == 0) {
         return {};
     }
 
+    float maxAbsRelevance = topDocuments[0].second;
     std::vector<RelativeIndex> result;
-    for (const auto& [doc_id, abs_rank] : relevanceVec) {
-        float relRank = abs_rank / maxAbsRelevance;
-        result.push_back({doc_id, relRank});
+    result.reserve(topDocuments.size());
+    for (const auto& [doc_id, abs_rank] : topDocuments) {
+        result.push_back({doc_id, abs_rank / maxAbsRelevance});
     }
 
-
-    std::sort(result.begin(), result.end(),
-              [](const RelativeIndex& a, const RelativeIndex& b) {
-                  if (std::abs(a.rank - b.rank) < 1e-6) {
-                      return a.doc_id < b.doc_id;
-                  }
-                  return a.rank > b.rank;
-              });
-
     return result;
 }
 
-std::vector<std::vector<RelativeIndex>> SearchServer::search(const std::vector<std::string>& queries_input) {
-    std::vector<std::vector<RelativeIndex>> results;
-    results.reserve(queries_input.size());
+std::vector<std::vector<RelativeIndex>> SearchServer::search(const std::vector<std::string>& queries_input,
+                                                             size_t limit) {
+    // Весь пакет выполняется по одному снимку, даже если индекс тем временем перестроен
+    auto snapshot = _index.Snapshot();
+    std::vector<std::vector<RelativeIndex>> results(queries_input.size());
+
+    ThreadPool& workers = _pool ? *_pool : ThreadPool::Shared();
+    size_t workerCount = _parallelism == 0 ? workers.Size() : _parallelism;
+    workerCount = std::min(workerCount, (queries_input.size() + queries_per_take - 1) / queries_per_take);
 
-    for (const auto& query : queries_input) {
-        auto queryResult = ProcessQuery(query);
-        results.push_back(queryResult);
+    if (workerCount <= 1) {
+        QueryScratch& scratch = ThreadScratch();
+        for (size_t i = 0; i < queries_input.size(); ++i) {
+            results[i] = ProcessQuery(*snapshot, queries_input[i], limit, scratch);
+        }
+        return results;
     }
 
+    // Каждый обработчик со своими буферами забирает запросы небольшими порциями, пока они
+    // не кончатся; ответ записывается на место запроса, поэтому порядок сохраняется
+    std::atomic<size_t> nextQuery{0};
+    workers.ParallelFor(workerCount, 1, [&](size_t, size_t) {
+        QueryScratch& scratch = ThreadScratch();
+        size_t begin;
+        while ((begin = nextQuery.fetch_add(queries_per_take)) < queries_input.size()) {
+            size_t end = std::min(queries_input.size(), begin + queries_per_take);
+            for (size_t i = begin; i < end; ++i) {
+                results[i] = ProcessQuery(*snapshot, queries_input[i], limit, scratch);
+            }
+        }
+    });
+
     return results;
+}
+
+void SearchServer::SetCacheCapacity(size_t bytes) {
+    _cache = bytes > 0 ? std::make_unique<ResultCache<std::vector<RelativeIndex>>>(bytes) : nullptr;
+}
+
+CacheStats SearchServer::GetCacheStats() const {
+    return _cache ? _cache->Stats() : CacheStats{};
 }
\ No newline at end of file
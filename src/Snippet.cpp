@@ -0,0 +1,90 @@
+#include "../include/Snippet.h"
+#include "../include/Tokenizer.h"
+#include <algorithm>
+
+namespace {
+    // Кусок текста, который разбивается на слова за раз
+    const size_t scan_chunk = 16 << 10;
+
+    bool IsSpace(char c) {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+    // Продолжение многобайтового символа UTF-8
+    bool IsContinuation(char c) {
+        return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+    }
+
+    // Находит первое вхождение одного из слов: begin и length - его байты в тексте
+    bool FindFirst(std::string_view text, const std::vector<std::string_view>& words, size_t& begin, size_t& length) {
+        Tokenizer tokenizer;
+        for (size_t chunk = 0; chunk < text.size();) {
+            // Кусок заканчивается на разделителе, чтобы слово не попало в два куска
+            size_t end = std::min(text.size(), chunk + scan_chunk);
+            while (end < text.size() && !IsSpace(text[end])) {
+                ++end;
+            }
+
+            for (std::string_view token : tokenizer.Tokenize(text.substr(chunk, end - chunk))) {
+                if (std::find(words.begin(), words.end(), token) != words.end()) {
+                    begin = chunk + tokenizer.Offset(token);
+                    length = token.size();
+                    return true;
+                }
+            }
+            chunk = end;
+        }
+
+        return false;
+    }
+}
+
+namespace Snippet {
+    std::string Extract(std::string_view text, const std::vector<std::string_view>& words, size_t width) {
+        size_t match = 0, length = 0;
+        FindFirst(text, words, match, length);
+
+        // Окно центрируется на слове и сдвигается к началу слов по обе стороны
+        size_t start = match - std::min(match, width > length ? (width - length) / 2 : 0);
+        while (start > 0 && start < match && !IsSpace(text[start - 1])) {
+            ++start;
+        }
+        while (start < match && IsSpace(text[start])) {
+            ++start;
+        }
+        size_t end = std::min(text.size(), std::max(start + width, match + length));
+        while (end < text.size() && end > match + length && !IsSpace(text[end])) {
+            --end;
+        }
+        while (start < match && IsContinuation(text[start])) {
+            ++start;
+        }
+        while (end < text.size() && end > start && IsContinuation(text[end])) {
+            --end;
+        }
+
+        std::string snippet;
+        if (start > 0) {
+            snippet += "...";
+        }
+
+        bool space = false, written = false;
+        for (size_t i = start; i < end; ++i) {
+            if (IsSpace(text[i])) {
+                space = true;
+                continue;
+            }
+            if (space && written) {
+                snippet += ' ';
+            }
+            space = false;
+            written = true;
+            snippet += text[i];
+        }
+
+        if (end < text.size()) {
+            snippet += "...";
+        }
+        return snippet;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,424 @@
+#include "../include/SpimiBuilder.h"
+#include "../include/IndexSegment.h"
+#include "../include/IndexSnapshot.h"
+#include "../include/PositionList.h"
+#include "../include/PostingList.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <random>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+    const size_t io_buffer_size = 1 << 20;
+
+    void PutVarint(std::string& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    // Прогон: термины по возрастанию, для каждого - длина и байты термина, число
+    // вхождений и пары (разность doc_id, count - 1), всё в varint. С позициями после
+    // каждой пары идут длина и байты позиций вхождения в формате PositionList.
+    class RunReader {
+    public:
+        RunReader(const std::string& path, bool with_positions)
+                : in(path, std::ios::binary), buffer(io_buffer_size), with_positions(with_positions) {
+            if (!in) {
+                throw std::runtime_error("unable to open index run " + path);
+            }
+        }
+
+
+        // Переходит к следующему термину; false - прогон закончился
+        bool NextTerm() {
+            if (position == end && !Fill()) {
+                return false;
+            }
+
+            term.resize(Varint());
+            for (char& c : term) {
+                c = static_cast<char>(Byte());
+            }
+            remaining = Varint();
+            previous_doc = 0;
+            return true;
+        }
+
+
+        const std::string& Term() const { return term; }
+
+
+        uint64_t Remaining() const { return remaining; }
+
+
+        void NextPosting(uint32_t& doc_id, uint32_t& count) {
+            previous_doc += static_cast<uint32_t>(Varint());
+            doc_id = previous_doc;
+            count = static_cast<uint32_t>(Varint()) + 1;
+            --remaining;
+
+            if (with_positions) {
+                positions.resize(Varint());
+                for (char& c : positions) {
+                    c = static_cast<char>(Byte());
+                }
+            }
+        }
+
+
+        // Позиции последнего прочитанного вхождения
+        const std::string& Positions() const { return positions; }
+
+    private:
+        std::ifstream in;
+        std::vector<char> buffer;
+        size_t position = 0;
+        size_t end = 0;
+        std::string term;
+        uint64_t remaining = 0;
+        uint32_t previous_doc = 0;
+        bool with_positions;
+        std::string positions;
+
+
+        bool Fill() {
+            in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            end = static_cast<size_t>(in.gcount());
+            position = 0;
+            return end > 0;
+        }
+
+
+        uint8_t Byte() {
+            if (position == end && !Fill()) {
+                throw std::runtime_error("index run is truncated");
+            }
+            return static_cast<uint8_t>(buffer[position++]);
+        }
+
+
+        uint64_t Varint() {
+            uint64_t value = 0;
+            for (uint32_t shift = 0;; shift += 7) {
+                uint8_t byte = Byte();
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0) {
+                    return value;
+                }
+            }
+        }
+    };
+
+    // Пишет секцию из count одинаковых по смыслу значений кусками, не выделяя память под все сразу
+    template <typename T, typename F>
+    void WriteGenerated(IndexSegment::Writer& writer, IndexSegment::Section section, size_t count, F value) {
+        std::vector<T> chunk;
+        chunk.reserve(std::min<size_t>(count, 1 << 16));
+
+        writer.BeginSection(section);
+        for (size_t begin = 0; begin < count; begin += chunk.capacity()) {
+            chunk.clear();
+            for (size_t i = begin; i < std::min(count, begin + chunk.capacity()); ++i) {
+                chunk.push_back(value(i));
+            }
+            writer.Write(chunk.data(), chunk.size() * sizeof(T));
+        }
+        writer.EndSection();
+    }
+}
+
+SpimiBuilder::SpimiBuilder(size_t memory_budget, const std::string& temp_directory, bool with_positions)
+        : memory_budget(memory_budget), with_positions(with_positions) {
+    fs::path directory = temp_directory.empty() ? fs::temp_directory_path() : fs::path(temp_directory);
+    fs::create_directories(directory);
+
+    // Случайная метка, чтобы одновременные построения не пересекались по именам файлов
+    std::random_device random;
+    uint64_t tag = (static_cast<uint64_t>(random()) << 32) | random();
+    temp_prefix = (directory / ("spimi-" + std::to_string(tag))).string();
+    segment_path = temp_prefix + ".seg";
+    positions_path = temp_prefix + ".pos";
+}
+
+SpimiBuilder::~SpimiBuilder() {
+    for (const auto& path : run_paths) {
+        std::error_code error;
+        fs::remove(path, error);
+    }
+
+    // Если Finish не завершился, сегмент мог остаться недописанным во временном файле Writer
+    std::error_code error;
+    fs::remove(positions_path, error);
+    if (!finished) {
+        fs::remove(segment_path, error);
+        fs::remove(segment_path + ".tmp", error);
+    }
+}
+
+size_t SpimiBuilder::MemoryUsage() const {
+    return terms.MemoryUsage() + lists.capacity() * sizeof(lists[0]) + positions.capacity() * sizeof(positions[0])
+           + posting_bytes;
+}
+
+void SpimiBuilder::AddDocument(std::string_view content) {
+    uint32_t doc_id = document_count++;
+    const auto& words = tokenizer.Tokenize(content);
+    lengths.push_back(static_cast<uint32_t>(words.size()));
+
+    for (size_t position = 0; position < words.size(); ++position) {
+        uint32_t id = terms.Insert(words[position]);
+        if (id == lists.size()) {
+            lists.emplace_back();
+            if (with_positions) {
+                positions.emplace_back();
+            }
+        }
+
+        if (with_positions) {
+            auto& term_positions = positions[id];
+            size_t capacity = term_positions.capacity();
+            term_positions.push_back(static_cast<uint32_t>(position));
+            posting_bytes += (term_positions.capacity() - capacity) * sizeof(uint32_t);
+        }
+
+        auto& entries = lists[id];
+        if (!entries.empty() && entries.back().doc_id == doc_id) {
+            ++entries.back().count;
+            continue;
+        }
+
+        size_t capacity = entries.capacity();
+        entries.push_back({doc_id, 1});
+        posting_bytes += (entries.capacity() - capacity) * sizeof(RunPosting);
+    }
+
+    if (MemoryUsage() > memory_budget) {
+        FlushRun();
+    }
+}
+
+void SpimiBuilder::FlushRun() {
+    std::vector<uint32_t> order(terms.Size());
+    for (uint32_t id = 0; id < order.size(); ++id) {
+        order[id] = id;
+    }
+    std::sort(order.begin(), order.end(),
+              [this](uint32_t a, uint32_t b) { return terms.Term(a) < terms.Term(b); });
+
+    std::string path = temp_prefix + "-" + std::to_string(run_paths.size()) + ".run";
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("unable to create index run " + path);
+    }
+    run_paths.push_back(path);
+
+    std::string buffer;
+    std::vector<uint8_t> encoded;
+    buffer.reserve(io_buffer_size + 64);
+    for (uint32_t id : order) {
+        const uint32_t* term_positions = with_positions ? positions[id].data() : nullptr;
+        std::string_view term = terms.Term(id);
+        PutVarint(buffer, term.size());
+        buffer.append(term.data(), term.size());
+        PutVarint(buffer, lists[id].size());
+
+        uint32_t previous = 0;
+        for (const RunPosting& posting : lists[id]) {
+            PutVarint(buffer, posting.doc_id - previous);
+            PutVarint(buffer, posting.count - 1);
+            previous = posting.doc_id;
+
+            if (with_positions) {
+                encoded.clear();
+                PositionList::Encode(term_positions, posting.count, encoded);
+                term_positions += posting.count;
+                PutVarint(buffer, encoded.size());
+                buffer.append(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+            }
+
+            if (buffer.size() >= io_buffer_size) {
+                out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                buffer.clear();
+            }
+        }
+    }
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+
+    out.close();
+    if (!out) {
+        throw std::runtime_error("unable to write index run " + path);
+    }
+
+    terms = TermDictionary();
+    std::vector<std::vector<RunPosting>>().swap(lists);
+    std::vector<std::vector<uint32_t>>().swap(positions);
+    posting_bytes = 0;
+}
+
+std::string SpimiBuilder::Finish() {
+    using namespace IndexSegment;
+
+    if (terms.Size() > 0) {
+        FlushRun();
+    }
+
+    std::vector<std::unique_ptr<RunReader>> readers;
+    for (const auto& path : run_paths) {
+        readers.push_back(std::make_unique<RunReader>(path, with_positions));
+    }
+
+    // Прогоны упорядочены по doc_id, поэтому при равных терминах первым идёт более ранний прогон
+    auto later = [&readers](size_t a, size_t b) {
+        int order = readers[a]->Term().compare(readers[b]->Term());
+        return order != 0 ? order > 0 : a > b;
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heap(later);
+    for (size_t run = 0; run < readers.size(); ++run) {
+        if (readers[run]->NextTerm()) {
+            heap.push(run);
+        }
+    }
+
+    Writer writer(segment_path);
+
+    // Позиции сливаются одновременно со списками, поэтому копятся во втором временном
+    // файле и переписываются в сегмент отдельной секцией после остальных
+    std::ofstream positions_out;
+    std::vector<uint64_t> position_offsets;
+    uint64_t position_total = 0;
+    if (with_positions) {
+        positions_out.open(positions_path, std::ios::binary | std::ios::trunc);
+        if (!positions_out) {
+            throw std::runtime_error("unable to create index positions file " + positions_path);
+        }
+    }
+
+    // Упакованные данные пишутся в файл по мере слияния, в памяти остаются только
+    // словарь и заголовки блоков
+    TermDictionary dictionary;
+    std::vector<PostingBlock> blocks;
+    std::vector<TermList> term_lists;
+    uint64_t word_total = 0;
+
+    uint32_t doc_ids[PostingList::block_size];
+    uint32_t counts[PostingList::block_size];
+    uint32_t words[PostingList::max_block_words];
+
+    writer.BeginSection(Words);
+    while (!heap.empty()) {
+        std::string term = readers[heap.top()]->Term();
+        TermList list{blocks.size(), word_total, 0, 0, 0, 0, position_offsets.size()};
+        size_t filled = 0;
+        uint32_t previous = 0;
+
+        auto flush_block = [&]() {
+            PostingBlock block{};
+            size_t count = PostingList::EncodeBlock(doc_ids, counts, filled, previous, block, words);
+            block.offset = static_cast<uint32_t>(word_total - list.first_word);
+            blocks.push_back(block);
+            list.max_count = std::max(list.max_count, block.max_count);
+            writer.Write(words, count * sizeof(uint32_t));
+            word_total += count;
+            previous = block.last_doc;
+            filled = 0;
+        };
+
+        while (!heap.empty() && readers[heap.top()]->Term() == term) {
+            size_t run = heap.top();
+            heap.pop();
+
+            RunReader& reader = *readers[run];
+            while (reader.Remaining() > 0) {
+                reader.NextPosting(doc_ids[filled], counts[filled]);
+                if (with_positions) {
+                    if (list.size % PositionList::group_size == 0) {
+                        position_offsets.push_back(position_total);
+                    }
+                    positions_out.write(reader.Positions().data(), static_cast<std::streamsize>(reader.Positions().size()));
+                    position_total += reader.Positions().size();
+                }
+                ++list.size;
+                if (++filled == PostingList::block_size) {
+                    flush_block();
+                }
+            }
+
+            if (reader.NextTerm()) {
+                heap.push(run);
+            }
+        }
+
+        if (filled > 0) {
+            flush_block();
+        }
+
+        list.block_count = static_cast<uint32_t>(blocks.size() - list.first_block);
+        list.word_count = static_cast<uint32_t>(word_total - list.first_word);
+        dictionary.Insert(term);
+        term_lists.push_back(list);
+    }
+    writer.EndSection();
+
+    Header& header = writer.GetHeader();
+    header.term_count = dictionary.Size();
+    header.slot_count = dictionary.SlotCount();
+    header.document_count = document_count;
+    header.internal_id_count = document_count;
+    header.identity_ids = 1;
+
+    writer.WriteSection(DictionarySlots, dictionary.SlotData(), dictionary.SlotCount() * sizeof(TermDictionary::Slot));
+    writer.WriteSection(TermOffsets, dictionary.OffsetData(), (dictionary.Size() + 1) * sizeof(uint64_t));
+    writer.WriteSection(TermArena, dictionary.ArenaData(), dictionary.ArenaSize());
+    writer.WriteSection(TermLists, term_lists.data(), term_lists.size() * sizeof(TermList));
+    writer.WriteSection(Blocks, blocks.data(), blocks.size() * sizeof(PostingBlock));
+
+    WriteGenerated<uint32_t>(writer, ExternalIds, document_count,
+                             [](size_t i) { return static_cast<uint32_t>(i); });
+    WriteGenerated<uint32_t>(writer, InternalIds, document_count,
+                             [](size_t i) { return static_cast<uint32_t>(i); });
+    WriteGenerated<uint64_t>(writer, DeletedDocuments, (document_count + 63) / 64,
+                             [](size_t) { return uint64_t(0); });
+
+    std::vector<float> norms = IndexSnapshot::LengthNorms(lengths, header.average_length);
+    std::vector<uint32_t>().swap(lengths);
+    header.minimum_norm = norms.empty() ? 0.0f : *std::min_element(norms.begin(), norms.end());
+    writer.WriteSection(DocumentNorms, norms.data(), norms.size() * sizeof(float));
+
+    if (with_positions) {
+        positions_out.close();
+        if (!positions_out) {
+            throw std::runtime_error("unable to write index positions file " + positions_path);
+        }
+        writer.WriteSection(PositionOffsets, position_offsets.data(), position_offsets.size() * sizeof(uint64_t));
+
+        std::ifstream positions_in(positions_path, std::ios::binary);
+        std::vector<char> chunk(io_buffer_size);
+        writer.BeginSection(PositionData);
+        while (positions_in.read(chunk.data(), static_cast<std::streamsize>(chunk.size())) || positions_in.gcount() > 0) {
+            writer.Write(chunk.data(), static_cast<size_t>(positions_in.gcount()));
+        }
+        writer.EndSection();
+        positions_in.close();
+
+        std::error_code error;
+        fs::remove(positions_path, error);
+    } else {
+        writer.WriteSection(PositionOffsets, nullptr, 0);
+        writer.WriteSection(PositionData, nullptr, 0);
+    }
+
+    std::string sources = EncodeSources({});
+    writer.WriteSection(SourceFiles, sources.data(), sources.size());
+    writer.Commit();
+
+    finished = true;
+    return segment_path;
+}
\ No newline at end of file
@@ -0,0 +1,169 @@
+#include "../include/TermDictionary.h"
+#include <algorithm>
+
+namespace {
+    const size_t min_slots = 16;
+
+    // Заполнение таблицы не выше 70%
+    bool NeedsGrow(size_t term_count, size_t slot_count) {
+        return term_count * 10 >= slot_count * 7;
+    }
+}
+
+uint64_t TermDictionary::Hash(std::string_view term) {
+    // FNV-1a: не зависит от реализации стандартной библиотеки
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : term) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+
+    return hash ^ (hash >> 32);
+}
+
+size_t TermDictionary::Probe(std::string_view term, uint64_t hash) const {
+    const Slot* table = SlotData();
+    size_t mask = SlotCount() - 1;
+    auto short_hash = static_cast<uint32_t>(hash);
+
+    // В повреждённой подключённой таблице может не оказаться пустой ячейки
+    for (size_t index = short_hash & mask, step = 0; step <= mask; index = (index + 1) & mask, ++step) {
+        const Slot& slot = table[index];
+        if (slot.id == npos || (slot.hash == short_hash && Term(slot.id) == term)) {
+            return index;
+        }
+    }
+    throw std::runtime_error("term dictionary is malformed");
+}
+
+uint32_t TermDictionary::Find(std::string_view term) const {
+    if (SlotCount() == 0) {
+        return npos;
+    }
+
+    return SlotData()[Probe(term, Hash(term))].id;
+}
+
+uint32_t TermDictionary::Insert(std::string_view term, uint64_t hash) {
+    // Подключённые таблицы копируются только ради нового термина: уже известный
+    // находится прямо в них
+    if (mapped_slots) {
+        uint32_t id = mapped_slot_count > 0 ? mapped_slots[Probe(term, hash)].id : npos;
+        if (id != npos) {
+            return id;
+        }
+        Detach();
+    }
+
+    if (NeedsGrow(Size() + 1, slots.size())) {
+        Rehash(std::max(min_slots, slots.size() * 2));
+    }
+
+    Slot& slot = slots[Probe(term, hash)];
+    if (slot.id != npos) {
+        return slot.id;
+    }
+
+    auto id = static_cast<uint32_t>(Size());
+    arena.insert(arena.end(), term.begin(), term.end());
+    offsets.push_back(arena.size());
+
+    slot.hash = static_cast<uint32_t>(hash);
+    slot.id = id;
+    return id;
+}
+
+void TermDictionary::Reserve(size_t term_count, size_t arena_bytes) {
+    Detach();
+    arena.reserve(arena_bytes);
+    offsets.reserve(term_count + 1);
+
+    size_t slot_count = std::max(min_slots, slots.size());
+    while (NeedsGrow(term_count, slot_count)) {
+        slot_count *= 2;
+    }
+
+    if (slot_count != slots.size()) {
+        Rehash(slot_count);
+    }
+}
+
+void TermDictionary::Clear() {
+    mapped_slots = nullptr;
+    std::fill(slots.begin(), slots.end(), Slot{0, npos});
+    arena.clear();
+    offsets.assign(1, 0);
+}
+
+void TermDictionary::Rehash(size_t slot_count) {
+    // Позиция в таблице зависит только от сохранённых младших битов хеша,
+    // поэтому строки терминов при перестроении не читаются
+    std::vector<Slot> old_slots(slot_count, Slot{0, npos});
+    old_slots.swap(slots);
+    size_t mask = slot_count - 1;
+
+    for (const Slot& slot : old_slots) {
+        if (slot.id == npos) {
+            continue;
+        }
+
+        size_t index = slot.hash & mask;
+        while (slots[index].id != npos) {
+            index = (index + 1) & mask;
+        }
+
+        slots[index] = slot;
+    }
+}
+
+void TermDictionary::Attach(const Slot* slot_data, size_t slot_count, const uint64_t* offset_data,
+                            size_t term_count, const char* arena_data) {
+    slots.clear();
+    slots.shrink_to_fit();
+    arena.clear();
+    arena.shrink_to_fit();
+    offsets.assign(1, 0);
+    offsets.shrink_to_fit();
+
+    mapped_slots = slot_data;
+    mapped_slot_count = slot_count;
+    mapped_offsets = offset_data;
+    mapped_term_count = term_count;
+    mapped_arena = arena_data;
+}
+
+void TermDictionary::Detach() {
+    if (!mapped_slots) {
+        return;
+    }
+
+    // Собственные таблицы читаются без проверок, поэтому подключённые проверяются при копировании
+    for (size_t index = 0; index < mapped_slot_count; ++index) {
+        uint32_t id = mapped_slots[index].id;
+        if (id != npos && id >= mapped_term_count) {
+            throw std::runtime_error("term dictionary is malformed");
+        }
+    }
+    for (size_t id = 0; id < mapped_term_count; ++id) {
+        if (mapped_offsets[id] > mapped_offsets[id + 1]) {
+            throw std::runtime_error("term dictionary is malformed");
+        }
+    }
+
+    slots.assign(mapped_slots, mapped_slots + mapped_slot_count);
+    offsets.assign(mapped_offsets, mapped_offsets + mapped_term_count + 1);
+    arena.assign(mapped_arena, mapped_arena + mapped_offsets[mapped_term_count]);
+    mapped_slots = nullptr;
+}
+
+size_t TermDictionary::MemoryUsage() const {
+    if (mapped_slots) {
+        return mapped_slot_count * sizeof(Slot)
+               + ArenaSize()
+               + (mapped_term_count + 1) * sizeof(uint64_t);
+    }
+
+    return slots.capacity() * sizeof(Slot)
+           + arena.capacity()
+           + offsets.capacity() * sizeof(uint64_t);
+}
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "../include/ThreadPool.h"
+#include <algorithm>
+#include <exception>
+
+namespace {
+    // Пул и номер очереди текущего рабочего потока (nullptr вне пула)
+    thread_local ThreadPool* current_pool = nullptr;
+    thread_local size_t current_index = 0;
+}
+
+ThreadPool::ThreadPool(size_t thread_count) {
+    if (thread_count == 0) {
+        thread_count = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < thread_count; ++i) {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+
+    workers.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    wake_up.notify_all();
+
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+ThreadPool& ThreadPool::Shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::Push(Task task) {
+    size_t index = (current_pool == this)
+                   ? current_index
+                   : next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        ++pending;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    wake_up.notify_one();
+}
+
+bool ThreadPool::TryPop(size_t index, Task& task) {
+    auto& queue = *queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    --pending;
+    return true;
+}
+
+bool ThreadPool::TrySteal(size_t thief, Task& task) {
+    for (size_t offset = 1; offset <= queues.size(); ++offset) {
+        auto& queue = *queues[(thief + offset) % queues.size()];
+        std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+        if (!lock.owns_lock() || queue.tasks.empty()) {
+            continue;
+        }
+
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        --pending;
+        return true;
+    }
+
+    return false;
+}
+
+bool ThreadPool::RunPendingTask() {
+    Task task;
+    size_t index = (current_pool == this) ? current_index : 0;
+
+    if ((current_pool == this && TryPop(index, task)) || TrySteal(index, task)) {
+        task();
+        return true;
+    }
+
+    return false;
+}
+
+void ThreadPool::WorkerLoop(size_t index) {
+    current_pool = this;
+    current_index = index;
+
+    while (true) {
+        Task task;
+        if (TryPop(index, task) || TrySteal(index, task)) {
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wake_up.wait(lock, [this]() { return stopping || pending > 0; });
+        if (stopping && pending == 0) {
+            return;
+        }
+    }
+}
+
+size_t ThreadPool::ChunkSize(size_t count) const {
+    size_t chunks = Size() * 4;
+    return std::max<size_t>(1, (count + chunks - 1) / chunks);
+}
+
+void ThreadPool::ParallelFor(size_t count, size_t chunk_size, const std::function<void(size_t, size_t)>& body) {
+    if (count == 0) {
+        return;
+    }
+
+    chunk_size = std::max<size_t>(1, chunk_size);
+    size_t chunk_count = (count + chunk_size - 1) / chunk_size;
+
+    std::atomic<size_t> next_chunk{0};
+    std::atomic<size_t> active_helpers{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto run_chunks = [&]() {
+        size_t chunk;
+        while ((chunk = next_chunk.fetch_add(1)) < chunk_count) {
+            size_t begin = chunk * chunk_size;
+            size_t end = std::min(count, begin + chunk_size);
+            try {
+                body(begin, end);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+    };
+
+    size_t helpers = std::min(Size(), chunk_count - 1);
+    active_helpers = helpers;
+    for (size_t i = 0; i < helpers; ++i) {
+        Push([&]() {
+            run_chunks();
+            --active_helpers;
+        });
+    }
+
+    run_chunks();
+
+    // Пока помощники не завершились, выполняем чужие задачи, а не ждём впустую
+    while (active_helpers > 0) {
+        if (!RunPendingTask()) {
+            std::this_thread::yield();
+        }
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
\ No newline at end of file
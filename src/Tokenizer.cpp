@@ -0,0 +1,183 @@
+#include "../include/Tokenizer.h"
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TOKENIZER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+    struct ScanState {
+        bool in_token = false;
+        size_t start = 0;
+    };
+
+    size_t CountTrailingZeros(uint64_t bits) {
+#if defined(__GNUC__)
+        return static_cast<size_t>(__builtin_ctzll(bits));
+#else
+        size_t count = 0;
+        while ((bits & 1) == 0) {
+            bits >>= 1;
+            ++count;
+        }
+        return count;
+#endif
+    }
+
+    // Пробельные символы те же, что у std::isspace в локали "C"
+    bool IsDelimiter(unsigned char c) {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+    // Переводит count <= 64 байт в нижний регистр, возвращает маску разделителей
+    uint64_t ClassifyScalar(const char* text, size_t count, char* lowered) {
+        uint64_t delimiters = 0;
+        for (size_t i = 0; i < count; ++i) {
+            auto c = static_cast<unsigned char>(text[i]);
+            if (IsDelimiter(c)) {
+                delimiters |= 1ull << i;
+            }
+            lowered[i] = static_cast<char>(c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+        }
+
+        return delimiters;
+    }
+
+    // Находит границы слов в блоке base..base+width по маске разделителей.
+    // Слово может начаться в одном блоке и закончиться в другом.
+    inline void EmitTokens(uint64_t delimiters, size_t base, size_t width, ScanState& state,
+                           const char* lowered, std::vector<std::string_view>& tokens) {
+        uint64_t valid = width == 64 ? ~0ull : (1ull << width) - 1;
+
+        for (size_t offset = 0; offset < width;) {
+            uint64_t bits = ((state.in_token ? delimiters : ~delimiters) & valid) >> offset;
+            if (bits == 0) {
+                return;
+            }
+
+            offset += CountTrailingZeros(bits);
+            if (state.in_token) {
+                tokens.emplace_back(lowered + state.start, base + offset - state.start);
+                state.in_token = false;
+            } else {
+                state.start = base + offset;
+                state.in_token = true;
+            }
+        }
+    }
+
+    // Хвост короче блока SIMD обрабатывается скалярно, байты за концом считаются разделителями
+    void ScanTail(const char* text, size_t base, size_t size, char* lowered, ScanState& state,
+                  std::vector<std::string_view>& tokens) {
+        for (; base < size; base += 64) {
+            size_t count = size - base < 64 ? size - base : 64;
+            uint64_t delimiters = ClassifyScalar(text + base, count, lowered + base);
+            if (count < 64) {
+                delimiters |= ~0ull << count;
+            }
+            EmitTokens(delimiters, base, 64, state, lowered, tokens);
+        }
+
+        if (state.in_token) {
+            tokens.emplace_back(lowered + state.start, size - state.start);
+        }
+    }
+
+    void ScanScalar(const char* text, size_t size, char* lowered, std::vector<std::string_view>& tokens) {
+        ScanState state;
+        ScanTail(text, 0, size, lowered, state, tokens);
+    }
+
+#ifdef TOKENIZER_X86
+    __attribute__((target("sse2")))
+    void ScanSse(const char* text, size_t size, char* lowered, std::vector<std::string_view>& tokens) {
+        const __m128i before_upper = _mm_set1_epi8('A' - 1);
+        const __m128i after_upper = _mm_set1_epi8('Z' + 1);
+        const __m128i case_bit = _mm_set1_epi8('a' - 'A');
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i before_tab = _mm_set1_epi8('\t' - 1);
+        const __m128i after_return = _mm_set1_epi8('\r' + 1);
+
+        ScanState state;
+        size_t base = 0;
+        for (; base + 16 <= size; base += 16) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + base));
+
+            // сравнения знаковые: байты >= 0x80 отрицательны и в диапазоны не попадают
+            __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(bytes, before_upper), _mm_cmpgt_epi8(after_upper, bytes));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lowered + base),
+                             _mm_add_epi8(bytes, _mm_and_si128(upper, case_bit)));
+
+            __m128i control = _mm_and_si128(_mm_cmpgt_epi8(bytes, before_tab), _mm_cmpgt_epi8(after_return, bytes));
+            __m128i delimiters = _mm_or_si128(_mm_cmpeq_epi8(bytes, space), control);
+
+            EmitTokens(static_cast<uint32_t>(_mm_movemask_epi8(delimiters)), base, 16, state, lowered, tokens);
+        }
+
+        ScanTail(text, base, size, lowered, state, tokens);
+    }
+
+    __attribute__((target("avx2")))
+    void ScanAvx2(const char* text, size_t size, char* lowered, std::vector<std::string_view>& tokens) {
+        const __m256i before_upper = _mm256_set1_epi8('A' - 1);
+        const __m256i after_upper = _mm256_set1_epi8('Z' + 1);
+        const __m256i case_bit = _mm256_set1_epi8('a' - 'A');
+        const __m256i space = _mm256_set1_epi8(' ');
+        const __m256i before_tab = _mm256_set1_epi8('\t' - 1);
+        const __m256i after_return = _mm256_set1_epi8('\r' + 1);
+
+        ScanState state;
+        size_t base = 0;
+        for (; base + 32 <= size; base += 32) {
+            __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + base));
+
+            __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, before_upper), _mm256_cmpgt_epi8(after_upper, bytes));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(lowered + base),
+                                _mm256_add_epi8(bytes, _mm256_and_si256(upper, case_bit)));
+
+            __m256i control = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, before_tab), _mm256_cmpgt_epi8(after_return, bytes));
+            __m256i delimiters = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, space), control);
+
+            EmitTokens(static_cast<uint32_t>(_mm256_movemask_epi8(delimiters)), base, 32, state, lowered, tokens);
+        }
+
+        ScanTail(text, base, size, lowered, state, tokens);
+    }
+#endif
+
+    struct Scanner {
+        const char* name;
+        void (*scan)(const char*, size_t, char*, std::vector<std::string_view>&);
+    };
+
+    Scanner SelectScanner() {
+#ifdef TOKENIZER_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return {"avx2", ScanAvx2};
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            return {"sse2", ScanSse};
+        }
+#endif
+        return {"scalar", ScanScalar};
+    }
+
+    const Scanner& ActiveScanner() {
+        static const Scanner scanner = SelectScanner();
+        return scanner;
+    }
+}
+
+const std::vector<std::string_view>& Tokenizer::Tokenize(std::string_view text) {
+    tokens.clear();
+    lowered.resize(text.size());
+
+    ActiveScanner().scan(text.data(), text.size(), lowered.data(), tokens);
+    return tokens;
+}
+
+const char* Tokenizer::ImplementationName() {
+    return ActiveScanner().name;
+}
\ No newline at end of file
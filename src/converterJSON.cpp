@@ -1,5 +1,8 @@
-#include "../include/ConverterJSON.h"
+#include "../include/converterJSON.h"
+#include "../include/MappedFile.h"
+#include "../include/Snippet.h"
 #include <nlohmann/json.hpp>
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
@@ -8,6 +11,137 @@
 using json = nlohmann::json;
 namespace fs = std::filesystem;
 
+namespace {
+    // Обработчик SAX для requests.json: строки массива "requests" корневого объекта
+    // передаются consume по мере разбора, остальные значения пропускаются без сохранения
+    class RequestsHandler : public json::json_sax_t {
+    public:
+        explicit RequestsHandler(const std::function<bool(std::string&&)>& consume) : consume(consume) {}
+
+
+        size_t Count() const { return count; }
+
+
+        // Чтение остановлено потребителем, а не ошибкой
+        bool Stopped() const { return stopped; }
+
+
+        const std::string& Error() const { return error; }
+
+
+        bool null() override { return Value(); }
+
+
+        bool boolean(bool) override { return Value(); }
+
+
+        bool number_integer(number_integer_t) override { return Value(); }
+
+
+        bool number_unsigned(number_unsigned_t) override { return Value(); }
+
+
+        bool number_float(number_float_t, const string_t&) override { return Value(); }
+
+
+        bool binary(binary_t&) override { return Value(); }
+
+
+        bool string(string_t& value) override {
+            if (!InRequests()) {
+                return Value();
+            }
+
+            ++count;
+            if (!consume(std::move(value))) {
+                stopped = true;
+                return false;
+            }
+            return true;
+        }
+
+
+        bool start_object(std::size_t) override {
+            if (!Value()) {
+                return false;
+            }
+            ++depth;
+            return true;
+        }
+
+
+        bool key(string_t& value) override {
+            requests_key = depth == 1 && value == "requests";
+            return true;
+        }
+
+
+        bool end_object() override {
+            --depth;
+            return true;
+        }
+
+
+        bool start_array(std::size_t) override {
+            bool opens_requests = depth == 1 && requests_key;
+            if (!Value()) {
+                return false;
+            }
+            ++depth;
+            in_requests = in_requests || opens_requests;
+            return true;
+        }
+
+
+        bool end_array() override {
+            if (--depth == 1) {
+                in_requests = false;
+            }
+            return true;
+        }
+
+
+        bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& e) override {
+            error = e.what();
+            return false;
+        }
+
+    private:
+        const std::function<bool(std::string&&)>& consume;
+        size_t depth = 0;
+        bool requests_key = false; // последний ключ корневого объекта - "requests"
+        bool in_requests = false;
+        size_t count = 0;
+        bool stopped = false;
+        std::string error;
+
+
+        bool InRequests() const { return in_requests && depth == 2; }
+
+
+        // Любое значение, кроме строки запроса: внутри массива запросов это ошибка
+        bool Value() {
+            requests_key = false;
+            if (InRequests()) {
+                error = "request " + std::to_string(count + 1) + " is not a string";
+                return false;
+            }
+            return true;
+        }
+    };
+
+    // Число потоков из config.json. Отрицательное значение nlohmann преобразовал бы
+    // в огромный size_t, поэтому оно читается со знаком и заменяется на 0 - по умолчанию.
+    size_t ReadThreadCount(const json& value, const char* name) {
+        auto count = value.get<int64_t>();
+        if (count < 0) {
+            std::cerr << "Warning: " << name << " in config.json is negative, using 0" << std::endl;
+            return 0;
+        }
+        return static_cast<size_t>(count);
+    }
+}
+
 ConverterJSON::ConverterJSON() {
     try {
         ReadConfig();
@@ -41,6 +175,62 @@ void ConverterJSON::ReadConfig() {
             this->max_responses = 5;
         }
 
+        if (config_data["config"].contains("thread_count")) {
+            this->thread_count = ReadThreadCount(config_data["config"]["thread_count"], "thread_count");
+        }
+
+        if (config_data["config"].contains("search_threads")) {
+            this->search_threads = ReadThreadCount(config_data["config"]["search_threads"], "search_threads");
+        }
+
+        if (config_data["config"].contains("cache_memory_mb")) {
+            this->cache_memory_mb = config_data["config"]["cache_memory_mb"];
+        }
+
+        if (config_data["config"].contains("build_mode")) {
+            this->build_mode = config_data["config"]["build_mode"];
+        }
+
+        if (config_data["config"].contains("evaluation")) {
+            this->evaluation = config_data["config"]["evaluation"];
+        }
+
+        if (config_data["config"].contains("intersection")) {
+            this->intersection = config_data["config"]["intersection"];
+        }
+
+        if (config_data["config"].contains("ranking")) {
+            this->ranking = config_data["config"]["ranking"];
+        }
+
+        if (config_data["config"].contains("match_mode")) {
+            this->match_mode = config_data["config"]["match_mode"];
+        }
+
+        if (config_data["config"].contains("min_match")) {
+            this->min_match = config_data["config"]["min_match"];
+        }
+
+        if (config_data["config"].contains("positions")) {
+            this->positions = config_data["config"]["positions"];
+        }
+
+        if (config_data["config"].contains("index_path")) {
+            this->index_path = config_data["config"]["index_path"];
+        }
+
+        if (config_data["config"].contains("memory_budget_mb")) {
+            this->memory_budget_mb = config_data["config"]["memory_budget_mb"];
+        }
+
+        if (config_data["config"].contains("temp_dir")) {
+            this->temp_dir = config_data["config"]["temp_dir"];
+        }
+
+        if (config_data["config"].contains("answers_format")) {
+            this->answers_format = config_data["config"]["answers_format"];
+        }
+
         this->file_paths.clear();
         if (config_data.contains("files") && !config_data["files"].empty()) {
             for (const auto& file_path : config_data["files"]) {
@@ -55,98 +245,354 @@ void ConverterJSON::ReadConfig() {
     }
 }
 
+bool ConverterJSON::ReadDocument(size_t file_index, std::string& content) {
+    const auto& file_path = this->file_paths[file_index];
+    auto& stamp = this->file_stamps[file_index];
+
+    try {
+        if (!fs::exists(file_path)) {
+            std::cerr << "Warning: File not found: " << file_path << std::endl;
+            return false;
+        }
+
+        std::ifstream file(file_path, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Warning: Unable to open file: " << file_path << std::endl;
+            return false;
+        }
+
+        // Файл читается одним вызовом в буфер известного размера
+        stamp.size = fs::file_size(file_path);
+        stamp.write_time = fs::last_write_time(file_path).time_since_epoch().count();
+        content.resize(stamp.size);
+        file.read(content.data(), static_cast<std::streamsize>(content.size()));
+        content.resize(static_cast<size_t>(file.gcount()));
+        return true;
+
+    } catch (const std::exception& e) {
+        std::cerr << "Error reading file " << file_path << ": " << e.what() << std::endl;
+        return false;
+    }
+}
+
 std::vector<std::string> ConverterJSON::GetTextDocuments() {
-    std::vector<std::string> documents;
-    
-    for (const auto& file_path : this->file_paths) {
-        try {
-            if (!fs::exists(file_path)) {
-                std::cerr << "Warning: File not found: " << file_path << std::endl;
-                continue;
-            }
-            
-            std::ifstream file(file_path);
-            if (!file.is_open()) {
-                std::cerr << "Warning: Unable to open file: " << file_path << std::endl;
-                continue;
+    DocumentLoader loader(ThreadPool::Shared());
+    auto documents = LoadTextDocuments(loader);
+    return std::vector<std::string>(documents.begin(), documents.end());
+}
+
+std::vector<std::string_view> ConverterJSON::LoadTextDocuments(DocumentLoader& loader) {
+    loader.Load(this->file_paths);
+
+    this->file_stamps.assign(this->file_paths.size(), SourceFile());
+    this->document_files.clear();
+    this->next_doc_id = 0;
+
+    std::vector<std::string_view> documents;
+    for (size_t i = 0; i < this->file_paths.size(); ++i) {
+        auto& stamp = this->file_stamps[i];
+        stamp.path = this->file_paths[i];
+
+        const auto& file = loader.GetFile(i);
+        if (file.status == DocumentLoader::Status::Missing) {
+            std::cerr << "Warning: File not found: " << stamp.path << std::endl;
+            continue;
+        }
+        if (file.status == DocumentLoader::Status::Unreadable) {
+            std::cerr << "Warning: Unable to open file: " << stamp.path << std::endl;
+            continue;
+        }
+
+        stamp.size = file.content.size();
+        stamp.write_time = file.write_time;
+        stamp.doc_id = static_cast<uint32_t>(this->next_doc_id++);
+        stamp.loaded = true;
+        this->document_files.push_back(i);
+        documents.push_back(file.content);
+    }
+
+    return documents;
+}
+
+void ConverterJSON::StreamTextDocuments(const std::function<void(const std::string&)>& consume) {
+    this->file_stamps.assign(this->file_paths.size(), SourceFile());
+    this->document_files.clear();
+    this->next_doc_id = 0;
+
+    std::string content;
+    for (size_t i = 0; i < this->file_paths.size(); ++i) {
+        auto& stamp = this->file_stamps[i];
+        stamp.path = this->file_paths[i];
+
+        if (!ReadDocument(i, content)) {
+            continue;
+        }
+
+        stamp.doc_id = static_cast<uint32_t>(this->next_doc_id++);
+        stamp.loaded = true;
+        this->document_files.push_back(i);
+        consume(content);
+    }
+}
+
+bool ConverterJSON::GetDocumentSnippet(size_t doc_id, const std::vector<std::string_view>& words, size_t width,
+                                       std::string& snippet) const {
+    if (doc_id >= this->document_files.size()) {
+        return false;
+    }
+
+    const auto& stamp = this->file_stamps[this->document_files[doc_id]];
+    if (!stamp.loaded) {
+        return false;
+    }
+
+    try {
+        MappedFile file(stamp.path);
+        snippet = Snippet::Extract(std::string_view(file.Data(), file.Size()), words, width);
+        return true;
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+}
+
+std::vector<DocumentChange> ConverterJSON::GetChangedDocuments() {
+    std::vector<DocumentChange> changes;
+    this->file_stamps.resize(this->file_paths.size());
+
+    for (size_t i = 0; i < this->file_paths.size(); ++i) {
+        auto& stamp = this->file_stamps[i];
+        stamp.path = this->file_paths[i];
+        std::error_code error;
+        bool exists = fs::exists(this->file_paths[i], error);
+
+        if (!exists) {
+            if (stamp.loaded) {
+                stamp.loaded = false;
+                changes.push_back({DocumentChange::Kind::Removed, stamp.doc_id, {}});
             }
-            
-            std::string content((std::istreambuf_iterator<char>(file)),
-                               std::istreambuf_iterator<char>());
-            documents.push_back(content);
-            
-        } catch (const std::exception& e) {
-            std::cerr << "Error reading file " << file_path << ": " << e.what() << std::endl;
+            continue;
+        }
+
+        if (stamp.loaded
+            && fs::file_size(this->file_paths[i], error) == stamp.size
+            && fs::last_write_time(this->file_paths[i], error).time_since_epoch().count() == stamp.write_time) {
+            continue;
+        }
+
+        std::string content;
+        if (!ReadDocument(i, content)) {
+            continue;
+        }
+
+        // Вернувшийся файл получает прежний номер документа
+        if (stamp.doc_id == SourceFile::no_document) {
+            stamp.doc_id = static_cast<uint32_t>(this->next_doc_id++);
+            this->document_files.resize(this->next_doc_id);
+            this->document_files[stamp.doc_id] = i;
         }
+
+        auto kind = stamp.loaded ? DocumentChange::Kind::Modified : DocumentChange::Kind::Added;
+        stamp.loaded = true;
+        changes.push_back({kind, stamp.doc_id, std::move(content)});
     }
-    
+
+    return changes;
+}
+
+std::vector<std::string> ConverterJSON::GetIndexedDocuments() const {
+    std::vector<std::string> documents;
+
+    for (const auto& stamp : this->file_stamps) {
+        if (!stamp.loaded) {
+            continue;
+        }
+
+        std::ifstream file(stamp.path);
+        if (!file.is_open()) {
+            std::cerr << "Warning: Unable to open file: " << stamp.path << std::endl;
+            continue;
+        }
+
+        if (stamp.doc_id >= documents.size()) {
+            documents.resize(stamp.doc_id + 1);
+        }
+        documents[stamp.doc_id].assign((std::istreambuf_iterator<char>(file)),
+                                       std::istreambuf_iterator<char>());
+    }
+
     return documents;
 }
 
+bool ConverterJSON::RestoreSourceFiles(std::vector<SourceFile> sources) {
+    if (sources.size() != this->file_paths.size()) {
+        return false;
+    }
+
+    size_t next_id = 0;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        if (sources[i].path != this->file_paths[i]) {
+            return false;
+        }
+        if (sources[i].doc_id != SourceFile::no_document) {
+            next_id = std::max<size_t>(next_id, sources[i].doc_id + 1);
+        }
+    }
+
+    this->file_stamps = std::move(sources);
+    this->next_doc_id = next_id;
+
+    this->document_files.assign(next_id, 0);
+    for (size_t i = 0; i < this->file_stamps.size(); ++i) {
+        if (this->file_stamps[i].doc_id != SourceFile::no_document) {
+            this->document_files[this->file_stamps[i].doc_id] = i;
+        }
+    }
+    return true;
+}
+
 int ConverterJSON::GetResponsesLimit() {
     return this->max_responses;
 }
 
+size_t ConverterJSON::GetThreadCount() const {
+    return this->thread_count;
+}
+
+size_t ConverterJSON::GetSearchThreads() const {
+    return this->search_threads;
+}
+
+size_t ConverterJSON::GetCacheMemory() const {
+    return this->cache_memory_mb * 1024 * 1024;
+}
+
+std::string ConverterJSON::GetBuildMode() const {
+    return this->build_mode;
+}
+
+std::string ConverterJSON::GetEvaluation() const {
+    return this->evaluation;
+}
+
+std::string ConverterJSON::GetRanking() const {
+    return this->ranking;
+}
+
+std::string ConverterJSON::GetIntersection() const {
+    return this->intersection;
+}
+
+std::string ConverterJSON::GetMatchMode() const {
+    return this->match_mode;
+}
+
+size_t ConverterJSON::GetMinimumMatch() const {
+    return this->min_match;
+}
+
+bool ConverterJSON::GetPositions() const {
+    return this->positions;
+}
+
+std::string ConverterJSON::GetIndexPath() const {
+    return this->index_path;
+}
+
+size_t ConverterJSON::GetMemoryBudget() const {
+    return this->memory_budget_mb * 1024 * 1024;
+}
+
+std::string ConverterJSON::GetTempDirectory() const {
+    return this->temp_dir;
+}
+
+std::string ConverterJSON::GetAnswersFormat() const {
+    return this->answers_format;
+}
+
 std::vector<std::string> ConverterJSON::GetRequests() {
     std::vector<std::string> requests;
-    
+    StreamRequests([&requests](std::string&& request) {
+        requests.push_back(std::move(request));
+        return true;
+    });
+    return requests;
+}
+
+size_t ConverterJSON::StreamRequests(const std::function<bool(std::string&&)>& consume) {
     if (!fs::exists(requests_path)) {
         std::cerr << "Warning: Requests file not found: " << requests_path << std::endl;
-        return requests;
+        return 0;
     }
-    
-    try {
-        std::ifstream requests_file(requests_path);
-        json requests_data;
-        requests_file >> requests_data;
-        
-        if (!requests_data.contains("requests") || requests_data["requests"].empty()) {
-            std::cerr << "Warning: No requests found in file" << std::endl;
-            return requests;
-        }
-        
-        for (const auto& request : requests_data["requests"]) {
-            requests.push_back(request);
-        }
-        
-    } catch (const json::exception& e) {
-        std::cerr << "Error parsing requests.json: " << e.what() << std::endl;
+
+    std::ifstream requests_file(requests_path, std::ios::binary);
+    RequestsHandler handler(consume);
+    json::sax_parse(requests_file, &handler);
+
+    if (!handler.Error().empty()) {
+        std::cerr << "Error parsing requests.json: " << handler.Error() << std::endl;
+    } else if (handler.Count() == 0) {
+        std::cerr << "Warning: No requests found in file" << std::endl;
     }
-    
-    return requests;
+    return handler.Count();
 }
 
-void ConverterJSON::putAnswers(std::vector<std::vector<std::pair<int, float>>> answers) {
-    json answers_json;
-    answers_json["answers"] = json::object();
-    
-    for (size_t i = 0; i < answers.size(); ++i) {
-        std::string requestId = "request" + std::string(3 - std::to_string(i + 1).length(), '0') + std::to_string(i + 1);
-        
-        if (answers[i].empty()) {
-            answers_json["answers"][requestId]["result"] = false;
-        } else {
-            answers_json["answers"][requestId]["result"] = true;
-
-            if (answers[i].size() > 1) {
-                json relevance = json::array();
-                
-                for (const auto& [doc_id, rank] : answers[i]) {
-                    json doc_info;
-                    doc_info["docid"] = doc_id;
-                    doc_info["rank"] = rank;
-                    relevance.push_back(doc_info);
-                }
-                
-                answers_json["answers"][requestId]["relevance"] = relevance;
-            } else {
-                answers_json["answers"][requestId]["docid"] = answers[i][0].first;
-                answers_json["answers"][requestId]["rank"] = answers[i][0].second;
+size_t ConverterJSON::StreamRequestLines(const std::string& path,
+                                         const std::function<bool(RequestLine&&)>& consume) const {
+    std::ifstream requests_file(path, std::ios::binary);
+    if (!requests_file.is_open()) {
+        throw std::runtime_error("cannot open requests file: " + path);
+    }
+
+    size_t count = 0, line_number = 0;
+    std::string line;
+    while (std::getline(requests_file, line)) {
+        ++line_number;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+
+        RequestLine request;
+        json value = json::parse(line, nullptr, false);
+        if (value.is_string()) {
+            request.text = value.get<std::string>();
+        } else if (value.is_object() && value.contains("request") && value["request"].is_string()) {
+            request.text = value["request"].get<std::string>();
+            // id возвращается в ответе как был: число остаётся числом, строка - строкой
+            if (value.contains("id") && (value["id"].is_string() || value["id"].is_number())) {
+                request.id = value["id"].dump();
             }
+        } else {
+            std::cerr << "Warning: " << path << ":" << line_number << " is not a valid request" << std::endl;
         }
+
+        ++count;
+        if (!consume(std::move(request))) {
+            break;
+        }
+    }
+    return count;
+}
+
+std::unique_ptr<AnswersWriter> ConverterJSON::OpenAnswers() const {
+    auto format = AnswersWriter::ParseFormat(this->answers_format);
+    std::string path = fs::path(this->answers_path).replace_extension(AnswersWriter::Extension(format)).string();
+    return std::make_unique<AnswersWriter>(path, format, this->max_responses > 0 ? this->max_responses : 0);
+}
+
+std::unique_ptr<AnswersWriter> ConverterJSON::OpenAnswerLines(const std::string& path) const {
+    std::string answers = path.empty()
+                          ? fs::path(this->answers_path).replace_extension(".jsonl").string() : path;
+    return std::make_unique<AnswersWriter>(answers, AnswersWriter::Format::JsonLines,
+                                           this->max_responses > 0 ? this->max_responses : 0);
+}
+
+void ConverterJSON::putAnswers(const std::vector<std::vector<std::pair<int, float>>>& answers) {
+    auto writer = OpenAnswers();
+    for (const auto& answer : answers) {
+        writer->Write(answer);
     }
-    std::ofstream answers_file(answers_path);
-    answers_file << std::setw(4) << answers_json << std::endl;
+    writer->Finish();
 }
 
 bool ConverterJSON::ConfigFileExists() const {
@@ -1,5 +1,9 @@
-#include "../include/ConverterJSON.h"
+#include "../include/BoundedQueue.h"
+#include "../include/converterJSON.h"
+#include "../include/DocumentLoader.h"
 #include "../include/InvertedIndex.h"
+#include "../include/Intersection.h"
+#include "../include/PhraseQuery.h"
 #include "../include/SearchServer.h"
 
 #include <iostream>
@@ -9,7 +13,7 @@
 #include <algorithm>
 #include <chrono>
 #include <filesystem>
-#include <set>
+#include <future>
 
 void printHeader(const std::string& title) {
     std::cout << "\n" << std::string(50, '=') << std::endl;
@@ -21,48 +25,207 @@ void printHelp() {
     printHeader("SEARCH ENGINE - HELP");
     std::cout << "Available commands:" << std::endl;
     std::cout << "  help                      - Show this help message" << std::endl;
-    std::cout << "  index                     - Re-index all documents" << std::endl;
-    std::cout << "  search <query>            - Search for documents (use quotes for multi-word query)" << std::endl;
+    std::cout << "  index                     - Apply changed, added and removed files to the index" << std::endl;
+    std::cout << "  reindex                   - Rebuild the index in the background, search keeps working" << std::endl;
+    std::cout << "  search <query>            - Search for documents (\"a b\" - phrase, a NEAR/3 b - nearby words)" << std::endl;
+    std::cout << "  explain <query>           - Show the query plan without running the search" << std::endl;
     std::cout << "  word <word>               - Show statistics for a specific word" << std::endl;
     std::cout << "  find <word> [docs]        - Find documents containing the word (optional limit)" << std::endl;
     std::cout << "  compare <word1> <word2>   - Compare frequency of two words" << std::endl;
     std::cout << "  stats                     - Show index statistics" << std::endl;
-    std::cout << "  process                   - Process all requests from requests.json" << std::endl;
+    std::cout << "  verify                    - Check the checksums of the saved index file" << std::endl;
+    std::cout << "  bench                     - Measure tokenizer throughput on loaded documents" << std::endl;
+    std::cout << "  process [file] [output]   - Process all requests from requests.json, or JSON Lines requests" << std::endl;
+    std::cout << "                              from file into output (default answers.jsonl)" << std::endl;
     std::cout << "  exit                      - Exit the program" << std::endl;
 }
 
-void performIndexing(ConverterJSON& converter, InvertedIndex& index) {
+void saveIndex(InvertedIndex& index, const std::string& path, const std::vector<SourceFile>& sources) {
+    if (path.empty()) {
+        return;
+    }
+
+    try {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        index.Save(path, sources);
+        auto endTime = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
+
+        std::cout << "Index saved to " << path << " in " << duration.count() << " ms" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Warning: Unable to save index: " << e.what() << std::endl;
+    }
+}
+
+// Словарь и списки сегмента проверяются по мере обращения к ним, а не по контрольным
+// суммам, поэтому файл целиком сверяется с контрольными суммами отдельной командой
+void verifySavedIndex(const ConverterJSON& converter) {
+    std::string path = converter.GetIndexPath();
+    if (path.empty() || !std::filesystem::exists(path)) {
+        std::cout << "No saved index to verify" << std::endl;
+        return;
+    }
+
+    try {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        IndexSegment::Reader(path).Verify();
+        auto endTime = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
+
+        std::cout << "Saved index " << path << " is intact (checked in " << duration.count() << " ms)" << std::endl;
+    } catch (const std::exception& e) {
+        std::cout << "Saved index is damaged: " << e.what() << std::endl;
+    }
+}
+
+// Строит индекс. Файлы загружаются параллельно и индексируются без копирования текстов;
+// в режиме spimi документы читаются по одному, чтобы корпус не держался в памяти целиком.
+void buildIndex(ConverterJSON& converter, InvertedIndex& index, ThreadPool& pool) {
+    size_t documentCount = 0;
+    if (converter.GetBuildMode() == "spimi") {
+        index.UpdateDocumentBase([&converter, &documentCount](const DocumentSink& sink) {
+            converter.StreamTextDocuments([&sink, &documentCount](const std::string& content) {
+                sink(content);
+                ++documentCount;
+            });
+        });
+    } else {
+        DocumentLoader loader(pool);
+        auto documents = converter.LoadTextDocuments(loader);
+        documentCount = documents.size();
+
+        double megabytes = static_cast<double>(loader.LoadedBytes()) / (1024 * 1024);
+        std::cout << "Loaded " << documentCount << " documents (" << std::fixed << std::setprecision(1)
+                  << megabytes << " MB) in " << std::setprecision(0) << loader.LoadSeconds() * 1000 << " ms";
+        if (loader.LoadSeconds() > 0) {
+            std::cout << ", " << std::setprecision(1) << megabytes / loader.LoadSeconds() << " MB/s";
+        }
+        std::cout << std::endl;
+
+        index.UpdateDocumentBase(documents);
+    }
+    std::cout << "Indexed " << documentCount << " documents" << std::endl;
+}
+
+// Документы читаются и индекс строится в отдельном потоке по копии конвертера: пока
+// построение идёт, поиск продолжает работать с прежним снимком индекса. Результат -
+// состояние файлов нового индекса (пусто при ошибке), его нужно вернуть в converter.
+std::future<std::vector<SourceFile>> startReindexing(const ConverterJSON& converter, InvertedIndex& index,
+                                                     ThreadPool& pool) {
     printHeader("INDEXING DOCUMENTS");
+    std::cout << "Indexing documents in the background..." << std::endl;
+
+    return std::async(std::launch::async, [&index, &pool, reader = converter]() mutable {
+        try {
+            auto startTime = std::chrono::high_resolution_clock::now();
+            buildIndex(reader, index, pool);
+            auto endTime = std::chrono::high_resolution_clock::now();
+            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
+
+            std::cout << "\nBackground indexing completed in " << duration.count() << " ms (index generation "
+                      << index.Snapshot()->Generation() << ")" << std::endl;
+            saveIndex(index, reader.GetIndexPath(), reader.GetSourceFiles());
+            return reader.GetSourceFiles();
+        } catch (const std::exception& e) {
+            std::cerr << "\nError during indexing: " << e.what() << std::endl;
+            return std::vector<SourceFile>();
+        }
+    });
+}
+
+void applyDocumentChanges(ConverterJSON& converter, InvertedIndex& index) {
+    printHeader("UPDATING INDEX");
     auto startTime = std::chrono::high_resolution_clock::now();
 
     try {
-        std::vector<std::string> documents = converter.GetTextDocuments();
-        std::cout << "Indexing " << documents.size() << " documents..." << std::endl;
+        auto changes = converter.GetChangedDocuments();
+        if (changes.empty()) {
+            std::cout << "No changes detected" << std::endl;
+            return;
+        }
 
-        index.UpdateDocumentBase(documents);
+        // Все изменения становятся видны поиску одновременно, одним снимком индекса
+        size_t added = 0, modified = 0, removed = 0;
+        index.BeginUpdate();
+        try {
+            for (auto& change : changes) {
+                switch (change.kind) {
+                    case DocumentChange::Kind::Added:
+                        index.AddDocument(change.doc_id, change.content);
+                        ++added;
+                        break;
+                    case DocumentChange::Kind::Modified:
+                        index.UpdateDocument(change.doc_id, change.content);
+                        ++modified;
+                        break;
+                    case DocumentChange::Kind::Removed:
+                        index.RemoveDocument(change.doc_id);
+                        ++removed;
+                        break;
+                }
+            }
+        } catch (...) {
+            index.EndUpdate();
+            throw;
+        }
+        index.EndUpdate();
 
         auto endTime = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
 
-        std::cout << "Indexing completed in " << duration.count() << " ms" << std::endl;
+        std::cout << "Added: " << added << ", modified: " << modified << ", removed: " << removed << std::endl;
+        std::cout << "Documents in index: " << index.GetDocumentCount() << std::endl;
+        std::cout << "Update completed in " << duration.count() << " ms" << std::endl;
+        saveIndex(index, converter.GetIndexPath(), converter.GetSourceFiles());
     } catch (const std::exception& e) {
-        std::cerr << "Error during indexing: " << e.what() << std::endl;
+        std::cerr << "Error during index update: " << e.what() << std::endl;
     }
 }
 
-std::string getDocumentPreview(const std::vector<std::string>& documents, size_t docId, size_t maxLength = 50) {
-    if (docId >= documents.size()) {
-        return "[Document not found]";
+// Открывает сохранённый индекс и применяет к нему изменения файлов.
+// false - индекса нет, он повреждён или список файлов изменился, нужна полная индексация.
+bool openSavedIndex(ConverterJSON& converter, InvertedIndex& index) {
+    std::string path = converter.GetIndexPath();
+    if (path.empty() || !std::filesystem::exists(path)) {
+        return false;
     }
 
-    std::string content = documents[docId];
-    if (content.length() > maxLength) {
-        return content.substr(0, maxLength) + "...";
+    auto startTime = std::chrono::high_resolution_clock::now();
+    try {
+        if (!converter.RestoreSourceFiles(index.Load(path))) {
+            std::cout << "File list in config.json changed, rebuilding index" << std::endl;
+            return false;
+        }
+        if (converter.GetPositions() && !index.Snapshot()->HasPositions()) {
+            std::cout << "Saved index has no word positions, rebuilding index" << std::endl;
+            return false;
+        }
+    } catch (const std::exception& e) {
+        std::cout << "Saved index is not usable (" << e.what() << "), rebuilding index" << std::endl;
+        return false;
     }
-    return content;
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
+    std::cout << "Opened saved index " << path << " (" << index.GetDocumentCount() << " documents, "
+              << index.Snapshot()->GetSegmentSize() / 1024 << " KB) in " << duration.count() << " ms" << std::endl;
+
+    applyDocumentChanges(converter, index);
+    return true;
 }
 
-void performSearch(const std::string& query, InvertedIndex& index, SearchServer& server, ConverterJSON& converter) {
+// Тексты документов в памяти не хранятся: для предпросмотра файл документа отображается
+// в память и берётся фрагмент вокруг первого из слов words (пусто - начало документа)
+std::string getDocumentPreview(const ConverterJSON& converter, size_t docId,
+                               const std::vector<std::string_view>& words = {}, size_t maxLength = 50) {
+    std::string snippet;
+    if (!converter.GetDocumentSnippet(docId, words, maxLength, snippet)) {
+        return "[Document not found]";
+    }
+    return snippet;
+}
+
+void performSearch(const std::string& query, SearchServer& server, ConverterJSON& converter) {
     printHeader("SEARCH RESULTS FOR: " + query);
 
     if (query.empty()) {
@@ -74,28 +237,27 @@ void performSearch(const std::string& query, InvertedIndex& index, SearchServer&
         auto startTime = std::chrono::high_resolution_clock::now();
 
         std::vector<std::string> queryVec = {query};
-        auto results = server.search(queryVec);
+        auto results = server.search(queryVec, converter.GetResponsesLimit());
 
         auto endTime = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
 
-        std::vector<std::string> documents = converter.GetTextDocuments();
-
         if (results.empty() || results[0].empty()) {
             std::cout << "No documents found for query: " << query << std::endl;
         } else {
-            std::cout << "Found " << results[0].size() << " document(s) in " << duration.count() << " ms" << std::endl;
+            std::cout << "Top " << results[0].size() << " document(s) in " << duration.count() << " ms" << std::endl;
             std::cout << std::setw(10) << "Doc ID" << std::setw(15) << "Relevance" << "  Content Preview" << std::endl;
             std::cout << std::string(70, '-') << std::endl;
 
-            size_t max_responses = converter.GetResponsesLimit();
-            size_t display_count = std::min(max_responses, results[0].size());
+            // Фрагменты берутся вокруг слов запроса без операторов и кавычек
+            Tokenizer tokenizer;
+            ParsedQuery parsed;
+            parsed.Parse(query, tokenizer);
 
-            for (size_t i = 0; i < display_count; ++i) {
-                const auto& result = results[0][i];
+            for (const auto& result : results[0]) {
                 std::cout << std::setw(10) << result.doc_id
                           << std::setw(15) << std::fixed << std::setprecision(6) << result.rank
-                          << "  " << getDocumentPreview(documents, result.doc_id) << std::endl;
+                          << "  " << getDocumentPreview(converter, result.doc_id, parsed.Words()) << std::endl;
             }
         }
     } catch (const std::exception& e) {
@@ -103,28 +265,78 @@ void performSearch(const std::string& query, InvertedIndex& index, SearchServer&
     }
 }
 
-void showWordStats(const std::string& word, InvertedIndex& index, const std::vector<std::string>& documents) {
-    printHeader("WORD STATISTICS: " + word);
+void explainQuery(const std::string& query, const SearchServer& server) {
+    printHeader("QUERY PLAN FOR: " + query);
 
-    if (word.empty()) {
-        std::cout << "Error: Word is empty" << std::endl;
+    if (query.empty()) {
+        std::cout << "Error: Empty search query" << std::endl;
         return;
     }
 
-    auto entries = index.GetWordCount(word);
+    QueryExplanation explanation = server.Explain(query);
+    const QueryPlan& plan = explanation.plan;
 
-    if (entries.empty()) {
-        std::cout << "Word '" << word << "' not found in any document" << std::endl;
+    const char* strategy = plan.strategy == EvaluationStrategy::Exhaustive ? "exhaustive"
+                           : plan.strategy == EvaluationStrategy::Daat ? "daat" : "block_max";
+    std::cout << "Evaluation: " << strategy << std::endl;
+    for (const std::string& constraint : explanation.constraints) {
+        std::cout << "Constraint: " << constraint << (plan.positional ? "" : " (ignored, no word positions)")
+                  << std::endl;
+    }
+
+    for (uint32_t word : plan.missing) {
+        std::cout << "Word '" << explanation.words[word] << "' not found in any document" << std::endl;
+    }
+    if (plan.empty) {
+        std::cout << "Result is empty, posting lists are not read" << std::endl;
         return;
     }
 
-    size_t totalCount = 0;
+    std::cout << "Documents must contain " << plan.minimum << " of " << plan.terms.size() << " word(s)" << std::endl;
+    if (plan.strategy == EvaluationStrategy::Exhaustive) {
+        const char* method = plan.method == IntersectionMethod::Bitmap ? "bitmap"
+                             : plan.method == IntersectionMethod::Gallop ? "gallop" : "merge";
+        std::cout << "Intersection: " << method << " (estimated " << std::fixed << std::setprecision(1)
+                  << plan.estimated_cost / 1000 << " us)" << std::endl;
+    }
+    std::cout << "Estimated matches: " << std::fixed << std::setprecision(0) << plan.estimated_matches << std::endl;
+    std::cout << std::endl;
+
+    std::cout << std::setw(20) << "Word" << std::setw(10) << "Term ID" << std::setw(12) << "Documents"
+              << std::setw(12) << "Max count" << std::setw(12) << "Max score" << std::endl;
+    std::cout << std::string(66, '-') << std::endl;
+    for (const PlannedTerm& term : plan.terms) {
+        std::cout << std::setw(20) << explanation.words[term.word] << std::setw(10) << term.term_id
+                  << std::setw(12) << term.document_frequency << std::setw(12) << term.max_count
+                  << std::setw(12) << std::fixed << std::setprecision(3) << term.max_score << std::endl;
+    }
+}
+
+void showWordStats(const std::string& word, InvertedIndex& index, const ConverterJSON& converter) {
+    printHeader("WORD STATISTICS: " + word);
+
+    if (word.empty()) {
+        std::cout << "Error: Word is empty" << std::endl;
+        return;
+    }
+
+    auto snapshot = index.Snapshot();
+    auto entries = snapshot->GetPostings(word);
+
+    // Size() учитывает ещё не вычищенные удалённые документы, поэтому считаем при обходе
+    size_t documentCount = 0, totalCount = 0;
     for (const auto& entry : entries) {
+        ++documentCount;
         totalCount += entry.count;
     }
 
+    if (documentCount == 0) {
+        std::cout << "Word '" << word << "' not found in any document" << std::endl;
+        return;
+    }
+
     std::cout << "Word: " << word << std::endl;
-    std::cout << "Found in " << entries.size() << " document(s)" << std::endl;
+    std::cout << "Found in " << documentCount << " document(s)" << std::endl;
     std::cout << "Total occurrences: " << totalCount << std::endl;
     std::cout << std::endl;
 
@@ -135,11 +347,11 @@ void showWordStats(const std::string& word, InvertedIndex& index, const std::vec
     for (const auto& entry : entries) {
         std::cout << std::setw(10) << entry.doc_id
                   << std::setw(10) << entry.count
-                  << "  " << getDocumentPreview(documents, entry.doc_id) << std::endl;
+                  << "  " << getDocumentPreview(converter, entry.doc_id, {word}) << std::endl;
     }
 }
 
-void findWordInDocuments(const std::string& word, InvertedIndex& index, const std::vector<std::string>& documents, int limit = -1) {
+void findWordInDocuments(const std::string& word, InvertedIndex& index, const ConverterJSON& converter, int limit = -1) {
     printHeader("DOCUMENTS CONTAINING: " + word);
 
     if (word.empty()) {
@@ -147,34 +359,56 @@ void findWordInDocuments(const std::string& word, InvertedIndex& index, const st
         return;
     }
 
-    auto entries = index.GetWordCount(word);
+    auto snapshot = index.Snapshot();
+    auto entries = snapshot->GetPostings(word);
 
-    if (entries.empty()) {
+    if (entries.Empty()) {
         std::cout << "Word '" << word << "' not found in any document" << std::endl;
         return;
     }
 
-    std::sort(entries.begin(), entries.end(),
-              [](const Entry& a, const Entry& b) { return a.count > b.count; });
+    // Для вывода нужны только limit самых частых вхождений: отбираем их кучей, не копируя весь список
+    size_t shown = limit > 0 ? std::min(static_cast<size_t>(limit), entries.Size()) : entries.Size();
+    auto byCount = [](const Entry& a, const Entry& b) {
+        return a.count > b.count || (a.count == b.count && a.doc_id < b.doc_id);
+    };
+
+    std::vector<Entry> topEntries;
+    topEntries.reserve(shown);
+    size_t documentCount = 0;
+    for (const Entry& entry : entries) {
+        ++documentCount;
+        if (topEntries.size() < shown) {
+            topEntries.push_back(entry);
+            std::push_heap(topEntries.begin(), topEntries.end(), byCount);
+        } else if (byCount(entry, topEntries.front())) {
+            std::pop_heap(topEntries.begin(), topEntries.end(), byCount);
+            topEntries.back() = entry;
+            std::push_heap(topEntries.begin(), topEntries.end(), byCount);
+        }
+    }
+    std::sort_heap(topEntries.begin(), topEntries.end(), byCount);
+
+    if (documentCount == 0) {
+        std::cout << "Word '" << word << "' not found in any document" << std::endl;
+        return;
+    }
 
-    std::cout << "Word '" << word << "' found in " << entries.size() << " document(s)" << std::endl;
+    std::cout << "Word '" << word << "' found in " << documentCount << " document(s)" << std::endl;
     std::cout << std::endl;
 
     std::cout << std::setw(10) << "Doc ID" << std::setw(10) << "Count"
               << "  Content Preview" << std::endl;
     std::cout << std::string(70, '-') << std::endl;
 
-    int count = 0;
-    for (const auto& entry : entries) {
+    for (const auto& entry : topEntries) {
         std::cout << std::setw(10) << entry.doc_id
                   << std::setw(10) << entry.count
-                  << "  " << getDocumentPreview(documents, entry.doc_id) << std::endl;
+                  << "  " << getDocumentPreview(converter, entry.doc_id, {word}) << std::endl;
+    }
 
-        count++;
-        if (limit > 0 && count >= limit) {
-            std::cout << "Showing " << count << " of " << entries.size() << " documents (limit reached)" << std::endl;
-            break;
-        }
+    if (limit > 0 && static_cast<size_t>(limit) <= documentCount) {
+        std::cout << "Showing " << topEntries.size() << " of " << documentCount << " documents (limit reached)" << std::endl;
     }
 }
 
@@ -186,43 +420,50 @@ void compareWords(const std::string& word1, const std::string& word2, InvertedIn
         return;
     }
 
-    auto entries1 = index.GetWordCount(word1);
-    auto entries2 = index.GetWordCount(word2);
+    auto snapshot = index.Snapshot();
+    auto entries1 = snapshot->GetPostings(word1);
+    auto entries2 = snapshot->GetPostings(word2);
 
     size_t totalCount1 = 0, totalCount2 = 0;
-    std::set<size_t> docIds;
+    size_t documentCount1 = 0, documentCount2 = 0;
 
     for (const auto& entry : entries1) {
+        ++documentCount1;
         totalCount1 += entry.count;
-        docIds.insert(entry.doc_id);
     }
 
     for (const auto& entry : entries2) {
+        ++documentCount2;
         totalCount2 += entry.count;
-        docIds.insert(entry.doc_id);
+    }
+
+    // Оба списка упорядочены по doc_id, поэтому общие документы находятся одним проходом
+    size_t commonDocs = 0;
+    auto cursor1 = entries1.Cursor();
+    auto cursor2 = entries2.Cursor();
+    while (!cursor1.AtEnd() && !cursor2.AtEnd()) {
+        if (cursor1.DocId() < cursor2.DocId()) {
+            cursor1.AdvanceTo(cursor2.DocId());
+        } else if (cursor2.DocId() < cursor1.DocId()) {
+            cursor2.AdvanceTo(cursor1.DocId());
+        } else {
+            ++commonDocs;
+            cursor1.Next();
+            cursor2.Next();
+        }
     }
 
     std::cout << "Word '" << word1 << "' statistics:" << std::endl;
-    std::cout << "  Documents: " << entries1.size() << std::endl;
+    std::cout << "  Documents: " << documentCount1 << std::endl;
     std::cout << "  Total occurrences: " << totalCount1 << std::endl;
 
     std::cout << "Word '" << word2 << "' statistics:" << std::endl;
-    std::cout << "  Documents: " << entries2.size() << std::endl;
+    std::cout << "  Documents: " << documentCount2 << std::endl;
     std::cout << "  Total occurrences: " << totalCount2 << std::endl;
 
-    std::cout << "Both words appear in " << docIds.size() << " unique document(s)" << std::endl;
+    std::cout << "Both words appear in " << documentCount1 + documentCount2 - commonDocs << " unique document(s)" << std::endl;
 
-    std::set<size_t> commonDocIds;
-    for (const auto& entry1 : entries1) {
-        for (const auto& entry2 : entries2) {
-            if (entry1.doc_id == entry2.doc_id) {
-                commonDocIds.insert(entry1.doc_id);
-                break;
-            }
-        }
-    }
-
-    std::cout << "Documents containing both words: " << commonDocIds.size() << std::endl;
+    std::cout << "Documents containing both words: " << commonDocs << std::endl;
 
     if (totalCount1 > 0 && totalCount2 > 0) {
         float ratio = static_cast<float>(totalCount1) / totalCount2;
@@ -231,9 +472,52 @@ void compareWords(const std::string& word1, const std::string& word2, InvertedIn
     }
 }
 
-void showStats(InvertedIndex& index) {
+void showStats(InvertedIndex& index, const SearchServer& server) {
     printHeader("INDEX STATISTICS");
 
+    auto snapshot = index.Snapshot();
+    std::cout << "Index generation: " << snapshot->Generation() << std::endl;
+    std::cout << "Documents: " << snapshot->GetDocumentCount() << std::endl;
+    std::cout << "Unique terms: " << snapshot->GetTermCount() << std::endl;
+    std::cout << "Dictionary memory: " << snapshot->GetDictionaryMemoryUsage() / 1024 << " KB" << std::endl;
+
+    size_t postingsCount = snapshot->GetPostingsCount();
+    size_t postingsMemory = snapshot->GetPostingsMemoryUsage();
+    std::cout << "Postings: " << postingsCount << " (" << postingsMemory / 1024 << " KB";
+    if (postingsCount > 0) {
+        std::cout << ", " << std::fixed << std::setprecision(2)
+                  << static_cast<double>(postingsMemory) / postingsCount << " bytes per posting";
+    }
+    std::cout << ")" << std::endl;
+    std::cout << "Postings decoder: " << BitPacking::DecoderName() << std::endl;
+    std::cout << "Intersection kernel: " << Intersection::KernelName() << std::endl;
+    if (snapshot->HasPositions()) {
+        std::cout << "Word positions: " << snapshot->GetPositionsMemoryUsage() / 1024 << " KB" << std::endl;
+    } else {
+        std::cout << "Word positions: not stored (phrases and NEAR match as plain words)" << std::endl;
+    }
+    if (snapshot->GetSegmentSize() > 0) {
+        std::cout << "Mapped index segment: " << snapshot->GetSegmentSize() / 1024 << " KB" << std::endl;
+    }
+
+    CacheStats cache = server.GetCacheStats();
+    if (cache.capacity > 0) {
+        uint64_t lookups = cache.hits + cache.misses;
+        std::cout << "Result cache: " << cache.entries << " entries, " << cache.memory / 1024 << " KB of "
+                  << cache.capacity / 1024 << " KB" << std::endl;
+        std::cout << "Cache hits: " << cache.hits << ", misses: " << cache.misses;
+        if (lookups > 0) {
+            std::cout << " (" << std::fixed << std::setprecision(1)
+                      << 100.0 * static_cast<double>(cache.hits) / lookups << "% hit rate)";
+        }
+        std::cout << std::endl;
+        std::cout << "Cache insertions: " << cache.insertions << ", evictions: " << cache.evictions
+                  << ", rejected: " << cache.rejections << ", invalidated: " << cache.invalidations << std::endl;
+    } else {
+        std::cout << "Result cache: disabled" << std::endl;
+    }
+    std::cout << std::endl;
+
     std::vector<std::string> commonWords = {"the", "a", "is", "of", "and", "in", "to", "it", "that", "for"};
 
     std::cout << "Statistics for common words:" << std::endl;
@@ -241,53 +525,182 @@ void showStats(InvertedIndex& index) {
     std::cout << std::string(45, '-') << std::endl;
 
     for (const auto& word : commonWords) {
-        auto entries = index.GetWordCount(word);
-        size_t totalCount = 0;
-        for (const auto& entry : entries) {
+        size_t documentCount = 0, totalCount = 0;
+        for (const auto& entry : snapshot->GetPostings(word)) {
+            ++documentCount;
             totalCount += entry.count;
         }
 
         std::cout << std::setw(15) << word
-                  << std::setw(15) << entries.size()
+                  << std::setw(15) << documentCount
                   << std::setw(15) << totalCount << std::endl;
     }
 }
 
-void processAllRequests(ConverterJSON& converter, SearchServer& server) {
-    printHeader("PROCESSING ALL REQUESTS");
+void benchmarkTokenizer(const std::vector<std::string>& documents) {
+    printHeader("TOKENIZER BENCHMARK");
 
-    try {
-        auto startTime = std::chrono::high_resolution_clock::now();
+    size_t totalBytes = 0;
+    for (const auto& document : documents) {
+        totalBytes += document.size();
+    }
 
-        std::vector<std::string> requests = converter.GetRequests();
-        std::cout << "Processing " << requests.size() << " requests..." << std::endl;
+    if (totalBytes == 0) {
+        std::cout << "No documents loaded" << std::endl;
+        return;
+    }
+
+    // Повторяем проходы, пока не наберётся достаточно времени для устойчивого замера
+    Tokenizer tokenizer;
+    size_t passes = 0, tokens = 0;
+    auto startTime = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed{0};
 
-        auto results = server.search(requests);
+    while (passes == 0 || elapsed.count() < 0.5) {
+        for (const auto& document : documents) {
+            tokens += tokenizer.Tokenize(document).size();
+        }
+        ++passes;
+        elapsed = std::chrono::high_resolution_clock::now() - startTime;
+    }
+
+    double megabytes = static_cast<double>(totalBytes) * passes / (1024.0 * 1024.0);
+    std::cout << "Implementation: " << Tokenizer::ImplementationName() << std::endl;
+    std::cout << "Passes: " << passes << ", bytes per pass: " << totalBytes
+              << ", tokens per pass: " << tokens / passes << std::endl;
+    std::cout << "Throughput: " << std::fixed << std::setprecision(1)
+              << megabytes / elapsed.count() << " MB/s" << std::endl;
+}
 
-        std::vector<std::vector<std::pair<int, float>>> formattedResults;
-        for (const auto& queryResult : results) {
-            std::vector<std::pair<int, float>> queryFormattedResult;
+// Запросы передаются между стадиями пакетами не больше requestBatchSize,
+// в каждой очереди между стадиями ждут не больше requestQueueSize запросов
+const size_t requestBatchSize = 1024;
+const size_t requestQueueSize = 4 * requestBatchSize;
+
+// Ответ на запрос по пути от поиска к записи
+struct AnswerLine {
+    std::string id;
+    std::vector<std::pair<int, float>> result;
+};
+
+// Конвейер из трёх стадий: read передаёт запросы (false - читать дальше не нужно), пакеты
+// запросов ищутся на пуле, ответы записываются в answers отдельным потоком по мере готовности.
+// Между стадиями ограниченные очереди, поэтому память не зависит от числа запросов,
+// а чтение, поиск и запись идут одновременно.
+void runRequestPipeline(SearchServer& server, size_t limit,
+                        const std::function<void(const std::function<bool(RequestLine&&)>&)>& read,
+                        AnswersWriter& answers) {
+    BoundedQueue<RequestLine> requests(requestQueueSize);
+    BoundedQueue<AnswerLine> results(requestQueueSize);
+
+    auto reader = std::async(std::launch::async, [&read, &requests]() {
+        try {
+            read([&requests](RequestLine&& request) { return requests.Push(std::move(request)); });
+        } catch (...) {
+            requests.Close();
+            throw;
+        }
+        requests.Close();
+    });
+
+    // Закрытая очередь ответов останавливает поиск, а тот - чтение
+    auto writer = std::async(std::launch::async, [&answers, &results]() {
+        std::vector<AnswerLine> batch;
+        try {
+            while (results.PopBatch(batch, requestBatchSize)) {
+                for (const auto& answer : batch) {
+                    answers.Write(answer.result, answer.id);
+                }
+                answers.Flush();
+            }
+            answers.Finish();
+        } catch (...) {
+            results.Close();
+            throw;
+        }
+    });
 
-            for (const auto& item : queryResult) {
-                queryFormattedResult.push_back({static_cast<int>(item.doc_id), item.rank});
+    std::vector<RequestLine> batch;
+    std::vector<std::string> queries;
+    try {
+        bool writing = true;
+        while (writing && requests.PopBatch(batch, requestBatchSize)) {
+            queries.clear();
+            for (auto& request : batch) {
+                queries.push_back(std::move(request.text));
             }
 
-            formattedResults.push_back(queryFormattedResult);
+            auto found = server.search(queries, limit);
+            for (size_t i = 0; i < batch.size() && writing; ++i) {
+                AnswerLine answer{std::move(batch[i].id), {}};
+                answer.result.reserve(found[i].size());
+                for (const auto& item : found[i]) {
+                    answer.result.push_back({static_cast<int>(item.doc_id), item.rank});
+                }
+                writing = results.Push(std::move(answer));
+            }
         }
+    } catch (...) {
+        requests.Close();
+        results.Close();
+        reader.wait();
+        writer.wait();
+        throw;
+    }
 
-        converter.putAnswers(formattedResults);
+    requests.Close();
+    results.Close();
+    reader.get();
+    writer.get();
+}
+
+// Выполняет запросы read и записывает ответы в файл, открытый open; false - обработка прервана ошибкой
+bool processRequests(ConverterJSON& converter, SearchServer& server,
+                     const std::function<void(const std::function<bool(RequestLine&&)>&)>& read,
+                     const std::function<std::unique_ptr<AnswersWriter>()>& open) {
+    try {
+        auto startTime = std::chrono::high_resolution_clock::now();
+
+        auto answers = open();
+        runRequestPipeline(server, converter.GetResponsesLimit(), read, *answers);
 
         auto endTime = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
 
-        std::cout << "All requests processed in " << duration.count() << " ms" << std::endl;
-        std::cout << "Results saved to answers.json" << std::endl;
+        std::cout << answers->Count() << " requests processed in " << duration.count() << " ms" << std::endl;
+        std::cout << "Results saved to " << answers->Path() << std::endl;
+        return true;
 
     } catch (const std::exception& e) {
         std::cerr << "Error processing requests: " << e.what() << std::endl;
+        return false;
     }
 }
 
+// requests.json разбирается потоково (SAX), ответы - в формате answers_format
+bool processAllRequests(ConverterJSON& converter, SearchServer& server) {
+    printHeader("PROCESSING ALL REQUESTS");
+
+    auto read = [&converter](const std::function<bool(RequestLine&&)>& consume) {
+        converter.StreamRequests([&consume](std::string&& request) {
+            return consume(RequestLine{{}, std::move(request)});
+        });
+    };
+    return processRequests(converter, server, read, [&converter]() { return converter.OpenAnswers(); });
+}
+
+// Запросы JSON Lines из requestsPath, ответы - строками JSON Lines в answersPath
+bool processRequestLines(ConverterJSON& converter, SearchServer& server,
+                         const std::string& requestsPath, const std::string& answersPath) {
+    printHeader("PROCESSING REQUEST LINES: " + requestsPath);
+
+    auto read = [&converter, &requestsPath](const std::function<bool(RequestLine&&)>& consume) {
+        converter.StreamRequestLines(requestsPath, consume);
+    };
+    return processRequests(converter, server, read,
+                           [&converter, &answersPath]() { return converter.OpenAnswerLines(answersPath); });
+}
+
 std::vector<std::string> parseCommand(const std::string& input) {
     std::vector<std::string> tokens;
     bool inQuotes = false;
@@ -313,24 +726,89 @@ std::vector<std::string> parseCommand(const std::string& input) {
     return tokens;
 }
 
-int main() {
+// Текст после имени команды как есть: кавычки в поисковом запросе задают фразы
+std::string commandArgument(const std::string& input) {
+    size_t start = input.find_first_not_of(' ');
+    size_t end = start == std::string::npos ? std::string::npos : input.find(' ', start);
+    size_t argument = end == std::string::npos ? std::string::npos : input.find_first_not_of(' ', end);
+    return argument == std::string::npos ? std::string() : input.substr(argument);
+}
+
+// Без аргументов - интерактивный режим. search_engine --process [file] [output] строит
+// или открывает индекс, обрабатывает запросы как команда process и завершается.
+int main(int argc, char* argv[]) {
+    bool headless = argc > 1 && std::string(argv[1]) == "--process";
+    if (argc > 1 && !headless) {
+        std::cerr << "Usage: " << argv[0] << " [--process [requests.jsonl] [answers.jsonl]]" << std::endl;
+        return 2;
+    }
+
     try {
         printHeader("SEARCH ENGINE");
-        std::cout << "Type 'help' for a list of commands" << std::endl;
+        if (!headless) {
+            std::cout << "Type 'help' for a list of commands" << std::endl;
+        }
 
         std::cout << "Current directory: " << std::filesystem::current_path() << std::endl;
 
         ConverterJSON converter;
         std::cout << "Search engine: " << converter.GetName() << " v" << converter.GetVersion() << std::endl;
 
-        std::vector<std::string> documents = converter.GetTextDocuments();
+        ThreadPool pool(converter.GetThreadCount());
+        std::cout << "Worker threads: " << pool.Size() << std::endl;
+
+        InvertedIndex index(pool);
+        std::string buildMode = converter.GetBuildMode();
+        index.SetBuildMode(buildMode == "locked" ? BuildMode::Locked
+                           : buildMode == "spimi" ? BuildMode::Spimi : BuildMode::Sharded);
+        index.SetMemoryBudget(converter.GetMemoryBudget());
+        index.SetTempDirectory(converter.GetTempDirectory());
+        index.SetPositions(converter.GetPositions());
+
+        if (!openSavedIndex(converter, index)) {
+            std::cout << "Indexing documents (" << buildMode << ")..." << std::endl;
+            buildIndex(converter, index, pool);
+            std::cout << "Indexing completed successfully" << std::endl;
+            saveIndex(index, converter.GetIndexPath(), converter.GetSourceFiles());
+        }
 
-        InvertedIndex index;
-        std::cout << "Indexing " << documents.size() << " documents..." << std::endl;
-        index.UpdateDocumentBase(documents);
-        std::cout << "Indexing completed successfully" << std::endl;
+        SearchServer server(index, pool);
+        server.SetParallelism(converter.GetSearchThreads());
+        server.SetCacheCapacity(converter.GetCacheMemory());
+        std::string evaluation = converter.GetEvaluation();
+        server.SetStrategy(evaluation == "exhaustive" ? EvaluationStrategy::Exhaustive
+                           : evaluation == "daat" ? EvaluationStrategy::Daat : EvaluationStrategy::BlockMax);
+        std::string intersection = converter.GetIntersection();
+        server.SetIntersection(intersection == "merge" ? IntersectionMethod::Merge
+                               : intersection == "gallop" ? IntersectionMethod::Gallop
+                               : intersection == "bitmap" ? IntersectionMethod::Bitmap : IntersectionMethod::Auto);
+        server.SetRanking(converter.GetRanking() == "bm25" ? RankingModel::Bm25 : RankingModel::Sum);
+        std::string matchMode = converter.GetMatchMode();
+        server.SetMatchMode(matchMode == "any" ? MatchMode::Any
+                            : matchMode == "at_least" ? MatchMode::AtLeast : MatchMode::All,
+                            converter.GetMinimumMatch());
+
+        if (headless) {
+            bool processed = argc > 2 ? processRequestLines(converter, server, argv[2], argc > 3 ? argv[3] : "")
+                                      : processAllRequests(converter, server);
+            return processed ? 0 : 1;
+        }
 
-        SearchServer server(index);
+        std::future<std::vector<SourceFile>> reindexing;
+        auto reindexingRunning = [&reindexing]() {
+            return reindexing.valid()
+                   && reindexing.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+        };
+
+        // Завершившееся фоновое построение передаёт состояние файлов нового индекса
+        auto collectReindexing = [&]() {
+            if (reindexing.valid() && !reindexingRunning()) {
+                auto sources = reindexing.get();
+                if (!sources.empty()) {
+                    converter.RestoreSourceFiles(std::move(sources));
+                }
+            }
+        };
 
         std::string input;
         bool running = true;
@@ -339,6 +817,7 @@ int main() {
             std::cout << "\n> ";
             std::getline(std::cin, input);
 
+            collectReindexing();
             if (input.empty()) {
                 continue;
             }
@@ -354,27 +833,32 @@ int main() {
             } else if (command == "exit" || command == "quit" || command == "q") {
                 std::cout << "Exiting search engine. Goodbye!" << std::endl;
                 running = false;
-            } else if (command == "index" || command == "reindex") {
-                performIndexing(converter, index);
-                documents = converter.GetTextDocuments();
+            } else if ((command == "index" || command == "reindex") && reindexingRunning()) {
+                std::cout << "Indexing is already running in the background" << std::endl;
+            } else if (command == "index") {
+                applyDocumentChanges(converter, index);
+            } else if (command == "reindex") {
+                reindexing = startReindexing(converter, index, pool);
             } else if (command == "search" || command == "s") {
                 if (tokens.size() < 2) {
                     std::cout << "Error: Search query required" << std::endl;
                     std::cout << "Usage: search <query>" << std::endl;
                 } else {
-                    std::string query;
-                    for (size_t i = 1; i < tokens.size(); ++i) {
-                        if (i > 1) query += " ";
-                        query += tokens[i];
-                    }
-                    performSearch(query, index, server, converter);
+                    performSearch(commandArgument(input), server, converter);
+                }
+            } else if (command == "explain" || command == "e") {
+                if (tokens.size() < 2) {
+                    std::cout << "Error: Search query required" << std::endl;
+                    std::cout << "Usage: explain <query>" << std::endl;
+                } else {
+                    explainQuery(commandArgument(input), server);
                 }
             } else if (command == "word" || command == "w") {
                 if (tokens.size() < 2) {
                     std::cout << "Error: Word required" << std::endl;
                     std::cout << "Usage: word <word>" << std::endl;
                 } else {
-                    showWordStats(tokens[1], index, documents);
+                    showWordStats(tokens[1], index, converter);
                 }
             } else if (command == "find" || command == "f") {
                 if (tokens.size() < 2) {
@@ -389,7 +873,7 @@ int main() {
                             std::cout << "Warning: Invalid limit format, showing all results" << std::endl;
                         }
                     }
-                    findWordInDocuments(tokens[1], index, documents, limit);
+                    findWordInDocuments(tokens[1], index, converter, limit);
                 }
             } else if (command == "compare" || command == "c") {
                 if (tokens.size() < 3) {
@@ -399,7 +883,13 @@ int main() {
                     compareWords(tokens[1], tokens[2], index);
                 }
             } else if (command == "stats") {
-                showStats(index);
+                showStats(index, server);
+            } else if (command == "verify") {
+                verifySavedIndex(converter);
+            } else if (command == "bench") {
+                benchmarkTokenizer(converter.GetIndexedDocuments());
+            } else if (command == "process" && tokens.size() > 1) {
+                processRequestLines(converter, server, tokens[1], tokens.size() > 2 ? tokens[2] : "");
             } else if (command == "process") {
                 processAllRequests(converter, server);
             } else {
@@ -408,6 +898,14 @@ int main() {
             }
         }
 
+        if (reindexingRunning()) {
+            std::cout << "Waiting for background indexing to finish..." << std::endl;
+        }
+        collectReindexing();
+        if (reindexing.valid()) {
+            reindexing.get();
+        }
+
         return 0;
 
     } catch (const std::exception& e) {